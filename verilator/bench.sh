@@ -0,0 +1,96 @@
+# Copyright 2008-2019 Frederic Requin
+#
+# This file is part of the 1943 FPGA core
+#
+# The 1943 FPGA core is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 3 of the License, or
+# (at your option) any later version.
+#
+# The 1943 FPGA core is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+#! /bin/sh
+
+#Simulation benchmark suite (run compile.sh first)
+#Usage : ./bench.sh          run the scenarios, compare against the baseline
+#        ./bench.sh --save   run the scenarios, save them as the new baseline
+#Each scenario runs BENCH_RUNS times : the median speed (simulated us per
+#wall second) and the peak RSS are compared against the baseline, a
+#difference above BENCH_THRESHOLD % is a regression (exit code 1)
+#The runs only save the end-of-run report (+perf_report) : the split timing
+#of +perf would slow down the measured simulation
+BENCH_RUNS=${BENCH_RUNS:-3}
+BENCH_THRESHOLD=${BENCH_THRESHOLD:-10}
+BENCH_BASELINE=${BENCH_BASELINE:-bench/baseline.csv}
+
+#Scenarios list
+SCN_FILE=bench/scenarios.txt
+
+#Verilated model
+SIM_EXE=./obj_dir/Vtop_1943
+OUT_DIR=./bench_out
+
+if [ ! -x $SIM_EXE ]; then
+    echo "$SIM_EXE not found, run compile.sh first"
+    exit 1
+fi
+if grep -q "^VM_TRACE *= *1" ./obj_dir/Vtop_1943_classes.mk 2>/dev/null; then
+    SIM_TRACE=on
+else
+    SIM_TRACE=off
+fi
+mkdir -p $OUT_DIR
+echo "name,sim_us_per_s,max_rss_kb" > $OUT_DIR/results.csv
+
+grep -v "^#" $SCN_FILE | while read NAME TRACE ARGS; do
+    [ -z "$NAME" ] && continue
+    #Tracing scenarios need a build with VCD tracing
+    if [ "$TRACE" != "-" ] && [ "$SIM_TRACE" = "off" ]; then
+        echo "$NAME : skipped (no VCD tracing in this build)"
+        continue
+    fi
+    rm -f $OUT_DIR/${NAME}_*.json
+    RUN=1
+    while [ $RUN -le $BENCH_RUNS ]; do
+        $SIM_EXE $ARGS +hash_log=/dev/null +perf_report=$OUT_DIR/${NAME}_$RUN.json > $OUT_DIR/${NAME}_$RUN.log
+        RUN=$((RUN + 1))
+    done
+    rm -f gpu_*.vcd gpu_*.fst
+    #Median speed, maximal peak RSS
+    SPEED=$(cat $OUT_DIR/${NAME}_*.json | sed -n 's/.*"sim_us_per_s": \([0-9.]*\).*/\1/p' | sort -g | \
+            awk '{ v[NR] = $1 } END { print (NR % 2) ? v[(NR + 1) / 2] : (v[NR / 2] + v[NR / 2 + 1]) / 2 }')
+    RSS=$(cat $OUT_DIR/${NAME}_*.json | sed -n 's/.*"max_rss_kb": \([0-9]*\).*/\1/p' | sort -n | tail -1)
+    echo "$NAME : $SPEED us/s, $RSS KB"
+    echo "$NAME,$SPEED,$RSS" >> $OUT_DIR/results.csv
+done
+
+if [ "$1" = "--save" ]; then
+    cp $OUT_DIR/results.csv $BENCH_BASELINE
+    echo "Baseline saved in file $BENCH_BASELINE"
+    exit 0
+fi
+if [ ! -f $BENCH_BASELINE ]; then
+    echo "No baseline ($BENCH_BASELINE), run ./bench.sh --save first"
+    exit 0
+fi
+
+#Comparison against the baseline
+awk -F, -v th=$BENCH_THRESHOLD '
+    FNR == 1 { next }
+    NR == FNR { base_spd[$1] = $2; base_rss[$1] = $3; next }
+    !($1 in base_spd) { printf("%-10s : no baseline\n", $1); next }
+    {
+        spd = ($2 - base_spd[$1]) * 100.0 / base_spd[$1];
+        rss = ($3 - base_rss[$1]) * 100.0 / base_rss[$1];
+        res = "ok";
+        if ((spd < -th) || (rss > th)) { res = "REGRESSION"; err = 1 }
+        printf("%-10s : speed %+6.1f %%, RSS %+6.1f %% : %s\n", $1, spd, rss, res);
+    }
+    END { exit err }
+' $BENCH_BASELINE $OUT_DIR/results.csv
@@ -0,0 +1,248 @@
+// Copyright 2008-2019 Frederic Requin
+//
+// This file is part of the 1943 FPGA core
+//
+// The 1943 FPGA core is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// The 1943 FPGA core is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// C++ models microbenchmarks:
+// ---------------------------
+//  - Synthetic traffic, without the verilated model
+//  - SDRAM : command streams with bursts, refreshes and DQM patterns
+//  - VideoOut : 1280 x 1024 DE/RGB streams (frames hashed, not saved)
+//  - ClockGen : 72 MHz + 108 MHz edges sequences
+//  - Usage : model_bench [<scale>]
+//
+
+#include "verilated.h"
+#include "../clock_gen/clock_gen.h"
+#include "../sdr_sdram/sdr_sdram.h"
+#include "../video_out/video_out.h"
+#include "../sim_perf/sim_perf.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+// SDRAM commands (RAS_N, CAS_N, WE_N)
+#define CMD_LMR   (0)
+#define CMD_REF   (1)
+#define CMD_PRE   (2)
+#define CMD_ACT   (3)
+#define CMD_WR    (4)
+#define CMD_RD    (5)
+#define CMD_NOP   (7)
+
+// SDRAM bus cycle
+typedef struct
+{
+    vluint8_t  cmd;
+    vluint8_t  ba;
+    vluint16_t addr;
+    vluint8_t  dqm;
+    vluint64_t dq;
+} sdram_cycle;
+
+// Video timing (108 MHz : 1716 clocks x 1052 lines, 1280 x 1024 active)
+#define VID_HTOTAL  (1716)
+#define VID_VTOTAL  (1052)
+#define VID_HACTIVE (1280)
+#define VID_VACTIVE (1024)
+
+static unsigned rnd_seed = 12345;
+
+static unsigned rnd()
+{
+    rnd_seed = rnd_seed * 1103515245 + 12345;
+    return rnd_seed >> 8;
+}
+
+static void result(const char *model, const char *test, vluint64_t calls, vluint64_t ns)
+{
+    printf("%-8s : %-24s : %10llu calls, %8.2f ns/call\n", model, test,
+           (unsigned long long)calls, (calls) ? (double)ns / (double)calls : 0.0);
+}
+
+// Build a legal command stream : activate, burst, precharge on the 4 banks
+// (write bursts with DQM patterns, read bursts), refresh every 64 rounds
+static int build_sdram_stream(sdram_cycle *buf, int max)
+{
+    int n = 0;
+    
+    #define PUSH(c, b, a, m, d) { buf[n].cmd = (c); buf[n].ba = (b); buf[n].addr = (a); \
+                                  buf[n].dqm = (m); buf[n].dq = (d); n++; }
+    
+    // All banks precharged, CAS latency 2, burst length 8
+    PUSH(CMD_PRE, 0, 0x400, 0, 0);
+    PUSH(CMD_NOP, 0, 0, 0, 0);
+    PUSH(CMD_LMR, 0, 0x023, 0, 0);
+    PUSH(CMD_NOP, 0, 0, 0, 0);
+    PUSH(CMD_NOP, 0, 0, 0, 0);
+    for (int round = 0; n + 256 < max; round++)
+    {
+        for (int ba = 0; ba < SDRAM_NUM_BANKS; ba++)
+        {
+            int row = rnd() & 4095;
+            int col = rnd() & 0x1F8;
+            
+            // Write burst
+            PUSH(CMD_ACT, ba, row, 0, 0);
+            PUSH(CMD_NOP, 0, 0, 0, 0);
+            PUSH(CMD_WR, ba, col, rnd() & 3, ((vluint64_t)rnd() << 32) ^ rnd());
+            for (int k = 1; k < 8; k++) PUSH(CMD_NOP, 0, 0, (k & 1) ? 0 : rnd() & 3, ((vluint64_t)rnd() << 32) ^ rnd());
+            PUSH(CMD_NOP, 0, 0, 0, 0);
+            PUSH(CMD_PRE, ba, 0, 0, 0);
+            PUSH(CMD_NOP, 0, 0, 0, 0);
+            // Read burst
+            PUSH(CMD_ACT, ba, row, 0, 0);
+            PUSH(CMD_NOP, 0, 0, 0, 0);
+            PUSH(CMD_RD, ba, col, 0, 0);
+            for (int k = 0; k < 10; k++) PUSH(CMD_NOP, 0, 0, 0, 0);
+            PUSH(CMD_PRE, ba, 0, 0, 0);
+            PUSH(CMD_NOP, 0, 0, 0, 0);
+        }
+        if ((round & 63) == 63)
+        {
+            // Refresh : all banks precharged
+            PUSH(CMD_PRE, 0, 0x400, 0, 0);
+            PUSH(CMD_NOP, 0, 0, 0, 0);
+            PUSH(CMD_REF, 0, 0, 0, 0);
+            for (int k = 0; k < 8; k++) PUSH(CMD_NOP, 0, 0, 0, 0);
+        }
+    }
+    #undef PUSH
+    
+    return n;
+}
+
+static void bench_sdram(const char *test, vluint8_t flags, int scale)
+{
+    SDRAM       *sdr;
+    sdram_cycle *buf;
+    int          len;
+    vluint64_t   ts = (vluint64_t)0;
+    vluint64_t   dq = (vluint64_t)0;
+    vluint64_t   sum = (vluint64_t)0;
+    vluint64_t   beg;
+    vluint64_t   calls = (vluint64_t)0;
+    
+    sdr = new SDRAM(12, 9, flags, NULL);
+    buf = new sdram_cycle[65536];
+    rnd_seed = 12345;
+    len = build_sdram_stream(buf, 65536);
+    
+    beg = SimPerf::now_ns();
+    for (int i = 0; i < scale * 256; i++)
+    {
+        // The mode register is only loaded once
+        for (int j = (i) ? 5 : 0; j < len; j++)
+        {
+            sdram_cycle *c = buf + j;
+            
+            sdr->eval_posedge(ts, (vluint8_t)0, (c->cmd >> 2) & 1, (c->cmd >> 1) & 1, c->cmd & 1,
+                              c->ba, c->addr, c->dqm, c->dq, dq);
+            sum += dq;
+            ts  += (vluint64_t)13890;
+        }
+        calls += (vluint64_t)(len - ((i) ? 5 : 0));
+    }
+    result("SDRAM", test, calls, SimPerf::now_ns() - beg);
+    if (sum == (vluint64_t)1) printf("\n");
+    
+    delete [] buf;
+    delete sdr;
+}
+
+static void bench_video(const char *test, bool native, int scale)
+{
+    VideoOut   *vga;
+    vluint64_t  beg;
+    vluint64_t  calls = (vluint64_t)0;
+    
+    vga = new VideoOut(0, 4, 0, 0, VID_HACTIVE, 0, VID_VACTIVE, "bench");
+    if (native) vga->set_native(4, 4, 192, 0, 224, 256, false);
+    // Frames are only hashed
+    vga->set_hash_mode((const char *)NULL, (const char *)NULL);
+    
+    beg = SimPerf::now_ns();
+    for (int f = 0; f < scale * 8; f++)
+    {
+        for (int y = 0; y < VID_VTOTAL; y++)
+        {
+            for (int x = 0; x < VID_HTOTAL; x++)
+            {
+                vluint8_t de = ((x < VID_HACTIVE) && (y < VID_VACTIVE)) ? 1 : 0;
+                
+                vga->eval_RGB444_DE_posedge(calls, de, (vluint8_t)(x >> 2), (vluint8_t)(y >> 2), (vluint8_t)(x ^ y));
+                calls++;
+            }
+        }
+    }
+    result("VideoOut", test, calls, SimPerf::now_ns() - beg);
+    
+    delete vga;
+}
+
+static void bench_clock(const char *test, bool timeline, bool stop, int scale)
+{
+    ClockGen   *clk;
+    vluint64_t  beg;
+    vluint64_t  calls = (vluint64_t)0;
+    vluint32_t  sum   = (vluint32_t)0;
+    
+    clk = new ClockGen(2, (vluint64_t)0);
+    // No console output in the timed loops
+    clk->SetVerbose(false);
+    clk->NewClock(0, (vluint64_t)13890, 0);
+    clk->StartClock(0);
+    clk->NewClock(1, (vluint64_t)9260, 0);
+    clk->StartClock(1);
+    clk->SetTimelineMode(timeline);
+    
+    beg = SimPerf::now_ns();
+    for (int i = 0; i < scale * 512; i++)
+    {
+        // Video clock stopped one lap out of 16
+        if ((stop) && ((i & 15) == 15)) clk->StopClock(1);
+        for (int j = 0; j < 65536; j++)
+        {
+            clk->AdvanceClocks();
+            sum += clk->GetEdgeMask();
+        }
+        if ((stop) && ((i & 15) == 15)) clk->StartClock(1, (vluint64_t)9260 - clk->GetTimeStampPs() % (vluint64_t)9260);
+        calls += (vluint64_t)65536;
+    }
+    result("ClockGen", test, calls, SimPerf::now_ns() - beg);
+    if (sum == (vluint32_t)1) printf("\n");
+    
+    delete clk;
+}
+
+int main(int argc, char **argv)
+{
+    int scale = (argc > 1) ? atoi(argv[1]) : 1;
+    
+    if (scale < 1) scale = 1;
+    
+    bench_sdram("16-bit, byte lanes",    FLAG_DATA_WIDTH_16, scale);
+    bench_sdram("16-bit, word storage",  FLAG_DATA_WIDTH_16 | FLAG_WORD_STORAGE, scale);
+    bench_sdram("16-bit, interleaved",   FLAG_DATA_WIDTH_16 | FLAG_WORD_STORAGE | FLAG_BANK_INTERLEAVING, scale);
+    bench_sdram("32-bit, word storage",  FLAG_DATA_WIDTH_32 | FLAG_WORD_STORAGE, scale);
+    
+    bench_video("1280 x 1024, hashed",   false, scale);
+    bench_video("224 x 256 native",      true,  scale);
+    
+    bench_clock("scan",                  false, false, scale);
+    bench_clock("timeline",              true,  false, scale);
+    bench_clock("timeline, stop/start",  true,  true,  scale);
+    
+    return 0;
+}
@@ -12,11 +12,23 @@ ClockGen::ClockGen(int num_clk, vluint64_t end_ps)
     max_stamp_ps   = (vluint64_t)0;
     curr_stamp_ps  = (vluint64_t)0;
     next_stamp_ps  = (vluint64_t)0;
+    edge_mask      = (vluint32_t)0;
     p_clk_stamp_ps = new vluint64_t[num_clk];
     p_clk_phase_ps = new vluint64_t[num_clk];
     p_clk_hper_ps  = new vluint64_t[num_clk];
     p_clk_state    = new vluint8_t[num_clk];
     p_clk_enable   = new bool[num_clk];
+    tl_enable      = false;
+    tl_valid       = false;
+    tl_steps       = 0;
+    tl_loop        = 0;
+    tl_idx         = 0;
+    tl_base_ps     = (vluint64_t)0;
+    tl_lap_ps      = (vluint64_t)0;
+    prog_stamp_ps  = PROGRESS_STEP_PS;
+    verbose        = true;
+    p_tl_offs_ps   = new vluint64_t[TIMELINE_MAX_STEPS];
+    p_tl_mask      = new vluint32_t[TIMELINE_MAX_STEPS];
     
     for (int i = 0; i < num_clk; i++)
     {
@@ -36,6 +48,8 @@ ClockGen::~ClockGen()
     delete [] p_clk_hper_ps;
     delete [] p_clk_state;
     delete [] p_clk_enable;
+    delete [] p_tl_offs_ps;
+    delete [] p_tl_mask;
 }
 
 // Create a new clock
@@ -57,15 +71,19 @@ void ClockGen::StartClock(int clk_idx)
 {
     if (clk_idx < num_clock)
     {
+        // Other clocks' time stamps are needed
+        if (tl_valid) SyncStamps();
         // Start with a 0
         p_clk_state[clk_idx] = (vluint8_t)0;
         // Next edge : one half period later
         p_clk_stamp_ps[clk_idx] = curr_stamp_ps + p_clk_hper_ps[clk_idx];
         // Enable the clock if the half period is not null
         p_clk_enable[clk_idx] = (p_clk_hper_ps[clk_idx]) ? true : false;
+        // New edges sequence
+        if (tl_enable) BuildTimeline();
         
-        printf("StartClock(%d) : time = %lld, phase = 0, stamp = %lld\n",
-               clk_idx, curr_stamp_ps, p_clk_stamp_ps[clk_idx]);
+        if (verbose) printf("StartClock(%d) : time = %lld, phase = 0, stamp = %lld\n",
+                            clk_idx, curr_stamp_ps, p_clk_stamp_ps[clk_idx]);
     }
 }
 
@@ -74,6 +92,8 @@ void ClockGen::StartClock(int clk_idx, vluint64_t phase_ps)
 {
     if (clk_idx < num_clock)
     {
+        // Other clocks' time stamps are needed
+        if (tl_valid) SyncStamps();
         // Start with a 0
         p_clk_state[clk_idx] = (vluint8_t)0;
         // Rising edge : phase shift + one half period later
@@ -85,9 +105,11 @@ void ClockGen::StartClock(int clk_idx, vluint64_t phase_ps)
         }
         // Enable the clock if the half period is not null
         p_clk_enable[clk_idx] = (p_clk_hper_ps[clk_idx]) ? true : false;
+        // New edges sequence
+        if (tl_enable) BuildTimeline();
         
-        printf("StartClock(%d) : time = %lld, phase = %lld, stamp = %lld\n",
-               clk_idx, curr_stamp_ps, phase_ps, p_clk_stamp_ps[clk_idx]);
+        if (verbose) printf("StartClock(%d) : time = %lld, phase = %lld, stamp = %lld\n",
+                            clk_idx, curr_stamp_ps, phase_ps, p_clk_stamp_ps[clk_idx]);
     }
 }
 
@@ -96,7 +118,11 @@ void ClockGen::StopClock(int clk_idx)
 {
     if (clk_idx < num_clock)
     {
+        // Other clocks' time stamps are needed
+        if (tl_valid) SyncStamps();
         p_clk_enable[clk_idx] = false;
+        // New edges sequence
+        if (tl_enable) BuildTimeline();
     }
 }
 
@@ -160,11 +186,27 @@ vluint64_t ClockGen::GetTimeStampPs()
     return curr_stamp_ps;
 }
 
-// Update clock states, compute next time stamp
+// Get the clocks toggled by the last AdvanceClocks() call
+vluint32_t ClockGen::GetEdgeMask()
+{
+    return edge_mask;
+}
+
+// Update clock states
 void ClockGen::AdvanceClocks()
+{
+    if (tl_valid)
+        AdvanceClocksTimeline();
+    else
+        AdvanceClocksScan();
+}
+
+// Update clock states, compute next time stamp
+void ClockGen::AdvanceClocksScan()
 {
     curr_stamp_ps = next_stamp_ps;
     next_stamp_ps += max_stamp_ps;
+    edge_mask     = (vluint32_t)0;
     
     for (int i = 0; i < num_clock; i++)
     {
@@ -175,6 +217,7 @@ void ClockGen::AdvanceClocks()
             {
                 p_clk_state[i]++;
                 p_clk_stamp_ps[i] += p_clk_hper_ps[i];
+                edge_mask |= (vluint32_t)1 << (i & 31);
             }
             // Find next time stamp
             if (p_clk_stamp_ps[i] < next_stamp_ps)
@@ -185,15 +228,267 @@ void ClockGen::AdvanceClocks()
     }
     
     // Show progress
-    if ((curr_stamp_ps & 0x3FFFF) == 0)
+    if (curr_stamp_ps >= prog_stamp_ps)
     {
         printf("\r%lld us", curr_stamp_ps / 1000000 );
         fflush(stdout);
+        prog_stamp_ps += PROGRESS_STEP_PS;
+    }
+}
+
+// Update clock states from the precomputed timeline
+void ClockGen::AdvanceClocksTimeline()
+{
+    vluint32_t mask;
+    
+    // Next step, wrap around at the end of a lap
+    if (++tl_idx == tl_steps)
+    {
+        tl_idx      = tl_loop;
+        tl_base_ps += tl_lap_ps;
+        
+        // Show progress (once per lap)
+        if (tl_base_ps >= prog_stamp_ps)
+        {
+            printf("\r%lld us", tl_base_ps / 1000000 );
+            fflush(stdout);
+            prog_stamp_ps += PROGRESS_STEP_PS;
+        }
     }
+    
+    curr_stamp_ps = tl_base_ps + p_tl_offs_ps[tl_idx];
+    
+    // Toggle the clocks that have an edge at this step
+    mask      = p_tl_mask[tl_idx];
+    edge_mask = mask;
+    for (int i = 0; mask; i++, mask >>= 1)
+    {
+        p_clk_state[i] += (vluint8_t)(mask & 1);
+    }
+}
+
+// Enable / disable the precomputed timeline, return true if it is in use
+bool ClockGen::SetTimelineMode(bool enable)
+{
+    if (tl_valid) SyncStamps();
+    
+    tl_enable = enable;
+    if (enable)
+        return BuildTimeline();
+    else
+        return false;
+}
+
+// Precompute the repeating edges sequence of the enabled clocks
+bool ClockGen::BuildTimeline()
+{
+    vluint64_t stamp_ps[32]; // Local copy of the clocks' time stamps
+    vluint64_t lap_ps;       // Least common multiple of the half periods
+    vluint64_t strt_ps;      // Start of the periodic part
+    vluint64_t last_ps;      // Time stamp of the last edge
+    int        steps;        // Number of steps (prefix + one lap)
+    int        loop;         // First step of the periodic part
+    
+    tl_valid = false;
+    
+    // Timeline only handles up to 32 clocks (one bit per clock)
+    if (num_clock > 32) return false;
+    
+    // The edges pattern repeats with the LCM of the half periods
+    lap_ps = (vluint64_t)0;
+    for (int i = 0; i < num_clock; i++)
+    {
+        if (p_clk_enable[i])
+        {
+            if (lap_ps)
+            {
+                vluint64_t a = lap_ps;
+                vluint64_t b = p_clk_hper_ps[i];
+                
+                // Greatest common divisor
+                while (b)
+                {
+                    vluint64_t t = a % b;
+                    a = b;
+                    b = t;
+                }
+                lap_ps = (lap_ps / a) * p_clk_hper_ps[i];
+            }
+            else
+            {
+                lap_ps = p_clk_hper_ps[i];
+            }
+        }
+        stamp_ps[i] = p_clk_stamp_ps[i];
+    }
+    if (!lap_ps) return false;
+    
+    // A clock started with a phase shift is periodic one half period before its first edge
+    strt_ps = curr_stamp_ps;
+    for (int i = 0; i < num_clock; i++)
+    {
+        if ((p_clk_enable[i]) && (stamp_ps[i] - p_clk_hper_ps[i] > strt_ps))
+        {
+            strt_ps = stamp_ps[i] - p_clk_hper_ps[i];
+        }
+    }
+    
+    // Walk through the prefix and one lap : edges in ]curr_stamp_ps, strt_ps + lap_ps]
+    steps   = 0;
+    loop    = 0;
+    last_ps = curr_stamp_ps;
+    while (true)
+    {
+        vluint64_t next_ps = last_ps + max_stamp_ps;
+        vluint32_t mask    = (vluint32_t)0;
+        
+        // Find next time stamp
+        for (int i = 0; i < num_clock; i++)
+        {
+            if ((p_clk_enable[i]) && (stamp_ps[i] < next_ps))
+            {
+                next_ps = stamp_ps[i];
+            }
+        }
+        if (next_ps > strt_ps + lap_ps) break;
+        if (next_ps <= strt_ps) loop = steps + 1;
+        
+        // Clocks toggling at this time stamp
+        for (int i = 0; i < num_clock; i++)
+        {
+            if ((p_clk_enable[i]) && (stamp_ps[i] == next_ps))
+            {
+                mask |= (vluint32_t)1 << i;
+                stamp_ps[i] += p_clk_hper_ps[i];
+            }
+        }
+        
+        // Edges sequence too long : stay in scan mode
+        if (steps == TIMELINE_MAX_STEPS)
+        {
+            printf("BuildTimeline() : more than %d steps, timeline disabled\n", TIMELINE_MAX_STEPS);
+            return false;
+        }
+        p_tl_offs_ps[steps] = next_ps - curr_stamp_ps;
+        p_tl_mask[steps]    = mask;
+        steps++;
+        last_ps = next_ps;
+    }
+    
+    // Start just before the first step
+    tl_steps   = steps;
+    tl_loop    = loop;
+    tl_idx     = -1;
+    tl_lap_ps  = lap_ps;
+    tl_base_ps = curr_stamp_ps;
+    tl_valid   = true;
+    
+    if (verbose) printf("BuildTimeline() : time = %lld, lap = %lld ps, %d steps (%d in prefix)\n",
+                        curr_stamp_ps, lap_ps, steps - loop, loop);
+    
+    return true;
+}
+
+// Recompute the clocks' time stamps from the timeline position
+void ClockGen::SyncStamps()
+{
+    next_stamp_ps = curr_stamp_ps + max_stamp_ps;
+    
+    for (int i = 0; i < num_clock; i++)
+    {
+        if (p_clk_enable[i])
+        {
+            vluint32_t bit = (vluint32_t)1 << i;
+            vluint64_t base_ps = tl_base_ps;
+            int        idx = tl_idx;
+            
+            // Next step where this clock has an edge
+            do
+            {
+                if (++idx == tl_steps)
+                {
+                    idx      = tl_loop;
+                    base_ps += tl_lap_ps;
+                }
+            }
+            while (!(p_tl_mask[idx] & bit));
+            
+            p_clk_stamp_ps[i] = base_ps + p_tl_offs_ps[idx];
+            if (p_clk_stamp_ps[i] < next_stamp_ps)
+            {
+                next_stamp_ps = p_clk_stamp_ps[i];
+            }
+        }
+    }
+    
+    tl_valid = false;
+}
+
+// Progress and clocks messages on/off (off : no console output in the
+// time-critical loop, e.g. for benchmarks)
+void ClockGen::SetVerbose(bool enable)
+{
+    verbose       = enable;
+    prog_stamp_ps = (enable) ? (curr_stamp_ps / PROGRESS_STEP_PS + 1) * PROGRESS_STEP_PS : ~(vluint64_t)0;
 }
 
 // Return true if simulation is over
 bool ClockGen::EndOfSimulation()
 {
     return (curr_stamp_ps >= end_stamp_ps);
-}
\ No newline at end of file
+}
+
+#if VM_SAVABLE
+// Save the clocks state (checkpoint)
+void ClockGen::SaveState(VerilatedSerialize &os)
+{
+    // Clocks' time stamps are needed
+    if (tl_valid) SyncStamps();
+    
+    os.write((void *)&num_clock,     sizeof(num_clock));
+    os.write((void *)&max_stamp_ps,  sizeof(max_stamp_ps));
+    os.write((void *)&curr_stamp_ps, sizeof(curr_stamp_ps));
+    os.write((void *)&next_stamp_ps, sizeof(next_stamp_ps));
+    os.write((void *)&edge_mask,     sizeof(edge_mask));
+    os.write((void *)&prog_stamp_ps, sizeof(prog_stamp_ps));
+    os.write((void *)p_clk_stamp_ps, sizeof(vluint64_t) * num_clock);
+    os.write((void *)p_clk_phase_ps, sizeof(vluint64_t) * num_clock);
+    os.write((void *)p_clk_hper_ps,  sizeof(vluint64_t) * num_clock);
+    os.write((void *)p_clk_state,    sizeof(vluint8_t)  * num_clock);
+    os.write((void *)p_clk_enable,   sizeof(bool)       * num_clock);
+    
+    // Same edges sequence
+    if (tl_enable) BuildTimeline();
+}
+
+// Restore the clocks state (checkpoint)
+bool ClockGen::RestoreState(VerilatedDeserialize &is)
+{
+    int num_clk;
+    
+    is.read((void *)&num_clk, sizeof(num_clk));
+    if (num_clk != num_clock)
+    {
+        printf("Checkpoint has %d clocks instead of %d !!\n", num_clk, num_clock);
+        return false;
+    }
+    
+    is.read((void *)&max_stamp_ps,  sizeof(max_stamp_ps));
+    is.read((void *)&curr_stamp_ps, sizeof(curr_stamp_ps));
+    is.read((void *)&next_stamp_ps, sizeof(next_stamp_ps));
+    is.read((void *)&edge_mask,     sizeof(edge_mask));
+    is.read((void *)&prog_stamp_ps, sizeof(prog_stamp_ps));
+    is.read((void *)p_clk_stamp_ps, sizeof(vluint64_t) * num_clock);
+    is.read((void *)p_clk_phase_ps, sizeof(vluint64_t) * num_clock);
+    is.read((void *)p_clk_hper_ps,  sizeof(vluint64_t) * num_clock);
+    is.read((void *)p_clk_state,    sizeof(vluint8_t)  * num_clock);
+    is.read((void *)p_clk_enable,   sizeof(bool)       * num_clock);
+    if (!verbose) prog_stamp_ps = ~(vluint64_t)0;
+    
+    // New edges sequence from the restored time stamps
+    tl_valid = false;
+    if (tl_enable) BuildTimeline();
+    
+    return true;
+}
+#endif /* VM_SAVABLE */
@@ -3,6 +3,14 @@
 #define _CLOCK_GEN_H_
 
 #include "verilated.h"
+#if VM_SAVABLE
+#include "verilated_save.h"
+#endif /* VM_SAVABLE */
+
+// Maximum number of steps in a precomputed edges timeline
+#define TIMELINE_MAX_STEPS (4096)
+// Progress display interval (in ps)
+#define PROGRESS_STEP_PS   ((vluint64_t)100000000)
 
 class ClockGen
 {
@@ -22,19 +30,43 @@ class ClockGen
         vluint8_t   GetClockStateDiv16(int clk_idx, vluint8_t phase); // phase : 0 - 31
         vluint8_t   GetClockStateDiv32(int clk_idx, vluint8_t phase); // phase : 0 - 63
         vluint64_t  GetTimeStampPs();
+        vluint32_t  GetEdgeMask();
         void        AdvanceClocks();
         bool        EndOfSimulation();
+        bool        SetTimelineMode(bool enable);
+        void        SetVerbose(bool enable);
+#if VM_SAVABLE
+        void        SaveState(VerilatedSerialize &os);
+        bool        RestoreState(VerilatedDeserialize &is);
+#endif /* VM_SAVABLE */
     private:
+        bool        BuildTimeline();
+        void        SyncStamps();
+        void        AdvanceClocksScan();
+        void        AdvanceClocksTimeline();
         int         num_clock;      // Number of clocks
         vluint64_t  end_stamp_ps;   // End of simulation time stamp (in ps)
         vluint64_t  max_stamp_ps;   // Maximal time stamp step (in ps)
         vluint64_t  curr_stamp_ps;  // Current time stamp (in ps)
         vluint64_t  next_stamp_ps;  // Next time stamp (in ps)
+        vluint32_t  edge_mask;      // Clocks toggled by the last step (bit #n : clock #n)
         vluint64_t *p_clk_stamp_ps; // Clocks' time stamps (in ps)
         vluint64_t *p_clk_phase_ps; // Clocks' phase (in ps)
         vluint64_t *p_clk_hper_ps;  // Clocks' half period (in ps)
         vluint8_t  *p_clk_state;    // Clocks' states (0 - 255)
         bool       *p_clk_enable;   // Enabled clocks 
+        // Precomputed edges timeline
+        bool        tl_enable;      // Timeline mode requested
+        bool        tl_valid;       // Timeline built and in use
+        int         tl_steps;       // Number of steps in the timeline
+        int         tl_loop;        // First step of the repeating lap
+        int         tl_idx;         // Current step in the timeline
+        vluint64_t  tl_base_ps;     // Time stamp of the current lap (in ps)
+        vluint64_t  tl_lap_ps;      // Duration of one timeline lap (in ps)
+        vluint64_t  prog_stamp_ps;  // Next progress display (in ps)
+        bool        verbose;        // Progress and clocks messages displayed
+        vluint64_t *p_tl_offs_ps;   // Edges time offsets (in ps)
+        vluint32_t *p_tl_mask;      // Edges clock masks (bit #n : clock #n)
 };
 
 #endif /* _CLOCK_GEN_H_ */
@@ -18,10 +18,38 @@
 #! /bin/sh
 
 #Options for GCC compiler
-COMPILE_OPT="-cc -O3 -CFLAGS -O3 -CFLAGS -Wno-attributes"
+COMPILE_OPT="-cc -O3 -CFLAGS -O3 -CFLAGS -Wno-attributes -CFLAGS -pthread -LDFLAGS -pthread"
 
-#Comment this line to disable VCD generation
-TRACE_OPT="-trace"
+#Waveforms format : vcd (default), fst or none
+#Usage : TRACE=fst ./compile.sh
+#FST files are much smaller, they are compressed by a dedicated writer thread
+#of the Verilator runtime, which makes it a multi-threaded build
+TRACE=${TRACE:-vcd}
+case "$TRACE" in
+    fst)  TRACE_OPT="--trace-fst --trace-threads 1" ;;
+    none) TRACE_OPT="" ;;
+    *)    TRACE_OPT="-trace" ;;
+esac
+
+#Number of threads for the verilated model (0 : single-threaded build)
+#Usage : THREADS=8 ./compile.sh
+#The C++ models (SDRAM, video output, clock generator) always run
+#in the main thread, between two evaluations of the model
+#MODEL_THREADS tells the testbench (VL_THREADED is always defined by Verilator 5)
+THREADS=${THREADS:-0}
+if [ "$THREADS" -gt 0 ]; then
+    THREAD_OPT="--threads $THREADS --threads-dpi none -CFLAGS -DMODEL_THREADS=$THREADS"
+else
+    THREAD_OPT=""
+fi
+
+#Checkpoints (+checkpoint=<frame>, +restore=<file>) : the model state must be
+#serializable, which is only supported by single-threaded builds
+if [ "$THREADS" -gt 0 ] || [ "$TRACE" = "fst" ]; then
+    SAVE_OPT=""
+else
+    SAVE_OPT="--savable -CFLAGS -DVM_SAVABLE=1"
+fi
 
 #Clock signals
 CLOCK_OPT=\
@@ -36,11 +64,22 @@ CPP_FILES=\
 "main.cpp\
  ./clock_gen/clock_gen.cpp\
  ./easy_bmp/EasyBMP.cpp\
+ ./input_movie/input_movie.cpp\
  ./sdr_sdram/sdr_sdram.cpp\
+ ./sim_perf/sim_perf.cpp\
+ ./vcd_ring/vcd_ring.cpp\
  ./video_out/video_out.cpp\
  verilated_dpi.cpp"
 
-verilator tb_top.v $COMPILE_OPT $TRACE_OPT $CLOCK_OPT -top-module $TOP_FILE -exe $CPP_FILES
+verilator tb_top.v $COMPILE_OPT $TRACE_OPT $THREAD_OPT $SAVE_OPT $CLOCK_OPT -top-module $TOP_FILE -exe $CPP_FILES
 cd ./obj_dir
 make -j -f V$TOP_FILE.mk V$TOP_FILE
 cd ..
+
+#SDRAM binary trace decoder
+g++ -O2 -o sdr_trace_dec ./sdr_sdram/sdr_trace_dec.cpp
+
+#C++ models microbenchmarks (SDRAM, video output, clock generator)
+VL_INC=$(verilator --getenv VERILATOR_ROOT)/include
+g++ -O3 -I$VL_INC -o model_bench ./bench/model_bench.cpp ./clock_gen/clock_gen.cpp ./easy_bmp/EasyBMP.cpp\
+ ./sdr_sdram/sdr_sdram.cpp ./sim_perf/sim_perf.cpp ./video_out/video_out.cpp -pthread
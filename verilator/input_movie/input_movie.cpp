@@ -0,0 +1,136 @@
+// Copyright 2008-2019 Frederic Requin
+//
+// This file is part of the 1943 FPGA core
+//
+// The 1943 FPGA core is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// The 1943 FPGA core is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "verilated.h"
+#include "input_movie.h"
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+// Sort the inputs changes by frame number (file order kept inside a frame)
+static bool event_before(const input_event &a, const input_event &b)
+{
+    return a.frame < b.frame;
+}
+
+// Constructor
+InputMovie::InputMovie()
+{
+    ev_idx    = 0;
+    fh_rec    = (FILE *)NULL;
+    rec_first = true;
+    memset((void *)rec_value, 0, sizeof(rec_value));
+}
+
+// Destructor
+InputMovie::~InputMovie()
+{
+    if (fh_rec) fclose(fh_rec);
+}
+
+// Load a movie file (replaces the current one)
+bool InputMovie::load(const char *name)
+{
+    FILE *fh;
+    char  line[256];
+    
+    fh = fopen(name, "r");
+    if (!fh)
+    {
+        printf("Cannot open input movie file \"%s\" !!\n", name);
+        return false;
+    }
+    
+    events.clear();
+    ev_idx = 0;
+    while (fgets(line, sizeof(line), fh))
+    {
+        input_event ev;
+        unsigned    val[INPUT_NUM];
+        
+        // Empty lines and comments are skipped
+        if (sscanf(line, "%d %x %x %x %x", &ev.frame, &val[0], &val[1], &val[2], &val[3]) != 5) continue;
+        
+        for (int i = 0; i < INPUT_NUM; i++)
+        {
+            ev.value[i] = (vluint8_t)val[i];
+        }
+        events.push_back(ev);
+    }
+    fclose(fh);
+    std::stable_sort(events.begin(), events.end(), event_before);
+    
+    printf("%d inputs changes loaded from input movie file \"%s\"\n", (int)events.size(), name);
+    
+    return true;
+}
+
+// Stop the playback (the inputs keep their current values)
+void InputMovie::clear()
+{
+    events.clear();
+    ev_idx = 0;
+}
+
+// Record the inputs into a movie file (replaces the current one)
+bool InputMovie::record(const char *name)
+{
+    if (fh_rec) fclose(fh_rec);
+    
+    fh_rec = fopen(name, "w");
+    if (!fh_rec)
+    {
+        printf("Cannot create input movie file \"%s\" !!\n", name);
+        return false;
+    }
+    fprintf(fh_rec, "# frame start_n coin_n joy1_n joy2_n\n");
+    rec_first = true;
+    
+    printf("Inputs recorded in file \"%s\"\n", name);
+    
+    return true;
+}
+
+// Beginning of a frame : apply the inputs changes up to this frame, record the resulting inputs
+void InputMovie::apply(int frame, vluint8_t &start_n, vluint8_t &coin_n, vluint8_t &joy1_n, vluint8_t &joy2_n)
+{
+    // Playback (the changes of the skipped frames are applied too)
+    while ((ev_idx < (int)events.size()) && (events[ev_idx].frame <= frame))
+    {
+        start_n = events[ev_idx].value[INPUT_START_N];
+        coin_n  = events[ev_idx].value[INPUT_COIN_N];
+        joy1_n  = events[ev_idx].value[INPUT_JOY1_N];
+        joy2_n  = events[ev_idx].value[INPUT_JOY2_N];
+        ev_idx++;
+    }
+    
+    // Recorder : only the changes are written
+    if (fh_rec)
+    {
+        if ((rec_first) ||
+            (rec_value[INPUT_START_N] != start_n) || (rec_value[INPUT_COIN_N] != coin_n) ||
+            (rec_value[INPUT_JOY1_N]  != joy1_n)  || (rec_value[INPUT_JOY2_N] != joy2_n))
+        {
+            fprintf(fh_rec, "%d %X %X %02X %02X\n", frame, start_n, coin_n, joy1_n, joy2_n);
+            rec_value[INPUT_START_N] = start_n;
+            rec_value[INPUT_COIN_N]  = coin_n;
+            rec_value[INPUT_JOY1_N]  = joy1_n;
+            rec_value[INPUT_JOY2_N]  = joy2_n;
+            rec_first = false;
+        }
+    }
+}
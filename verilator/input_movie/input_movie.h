@@ -0,0 +1,68 @@
+// Copyright 2008-2019 Frederic Requin
+//
+// This file is part of the 1943 FPGA core
+//
+// The 1943 FPGA core is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// The 1943 FPGA core is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Input movie:
+// ------------
+//  - Drives the players inputs (start, coin, joysticks) frame by frame
+//  - Text format, one line per change : <frame> <start_n> <coin_n> <joy1_n> <joy2_n>
+//    (frame number in decimal, active low inputs in hex, '#' for comments)
+//  - The inputs of a line are applied from the beginning of its frame
+//  - The recorder writes the same format, from any source of inputs
+//
+
+#ifndef _INPUT_MOVIE_H_
+#define _INPUT_MOVIE_H_
+
+#include "verilated.h"
+#include <vector>
+
+// Players inputs (same order as in the movie file)
+#define INPUT_START_N (0)
+#define INPUT_COIN_N  (1)
+#define INPUT_JOY1_N  (2)
+#define INPUT_JOY2_N  (3)
+#define INPUT_NUM     (4)
+
+// Inputs change
+typedef struct
+{
+    int        frame;                          // Frame number
+    vluint8_t  value[INPUT_NUM];               // Inputs values
+} input_event;
+
+class InputMovie
+{
+    public:
+        // Constructor and destructor
+        InputMovie();
+        ~InputMovie();
+        // Methods
+        bool       load(const char *name);
+        void       clear();
+        bool       record(const char *name);
+        void       apply(int frame, vluint8_t &start_n, vluint8_t &coin_n, vluint8_t &joy1_n, vluint8_t &joy2_n);
+    private:
+        // Playback
+        std::vector<input_event> events;       // Inputs changes (sorted by frame number)
+        int        ev_idx;                     // Next change to apply
+        // Recorder
+        FILE      *fh_rec;
+        vluint8_t  rec_value[INPUT_NUM];       // Last recorded inputs
+        bool       rec_first;                  // Nothing recorded yet
+};
+
+#endif /* _INPUT_MOVIE_H_ */
@@ -16,44 +16,153 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "Vtop_1943.h"
+#include "Vtop_1943___024root.h"
 #include "verilated.h"
 #include "clock_gen/clock_gen.h"
 #include "sdr_sdram/sdr_sdram.h"
 #include "video_out/video_out.h"
+#include "input_movie/input_movie.h"
+#include "sim_perf/sim_perf.h"
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
 
 #if VM_TRACE
+#if VM_TRACE_FST
+// FST traces : compressed by the writer thread of the Verilator runtime
+#include "verilated_fst_c.h"
+#define TRACE_CLASS VerilatedFstC
+#define TRACE_EXT   "fst"
+#else
 #include "verilated_vcd_c.h"
-#endif
+#include "vcd_ring/vcd_ring.h"
+#define TRACE_CLASS VerilatedVcdC
+#define TRACE_EXT   "vcd"
+#endif /* VM_TRACE_FST */
+#endif /* VM_TRACE */
 
 // Period for a 72 MHz clock
 #define PERIOD_72MHz_ps    ((vluint64_t)13890)
 // Period for a 108 MHz clock
 #define PERIOD_108MHz_ps   ((vluint64_t)9260)
+// Video frame period (1716 clocks x 1052 lines, same as 4576 x 263 bus clocks)
+#define FRAME_PERIOD_ps    ((vluint64_t)1716 * (vluint64_t)1052 * PERIOD_108MHz_ps)
+// Capture window : frames simulated with the video clock before the first captured one
+#define CAPTURE_LEAD       (2)
+// Clock edges masks (from ClockGen::GetEdgeMask())
+#define BUS_CLK_EDGE       ((vluint32_t)0x01)
+#define VID_CLK_EDGE       ((vluint32_t)0x02)
 // SDRAM size
 #define SDRAM_BIT_ROWS     (12)
 #define SDRAM_BIT_COLS     (9)
 #define SDRAM_SIZE         (2 << (SDRAM_BIT_ROWS + SDRAM_BIT_COLS + SDRAM_BIT_BANKS))
-
-// Clocks generation (global)
-ClockGen *clk;
+// SDRAM profiler : one arcade line is 286 phases of 16 bus clocks (sdram_ctrl.v),
+// with one access slot per bank and per phase
+#define SDRAM_LINE_CYCLES  (4576)
+#define SDRAM_LINE_SLOTS   (286)
+// SDRAM heatmap : 1 KB pages
+#define SDRAM_HEAT_PAGE    (10)
+// SDRAM timings checker : MT48LC8M16A2-7E at 72 MHz (in bus clocks)
+#define SDRAM_T_RCD        (2)    // 15 ns
+#define SDRAM_T_RP         (2)    // 15 ns
+#define SDRAM_T_RAS        (3)    // 37 ns
+#define SDRAM_T_RC         (5)    // 60 ns
+#define SDRAM_T_WR         (2)    // 1 clock + 7 ns
+#define SDRAM_T_RFC        (5)    // 66 ns
+#define SDRAM_T_REFI       (1124) // 64 ms / 4096 rows
+// Native resolution capture (default) : 224 x 256 arcade frame, upscaled 4 x 4
+// into the 1280 x 1024 output by the scandoubler (the line FIFO holds the pixels
+// 16 - 239 of 256, its 256 pixels are read from the 128th output pixel)
+#define NATIVE_HSCALE      (4)
+#define NATIVE_VSCALE      (4)
+#define NATIVE_HOFFSET     (192)
+#define NATIVE_VOFFSET     (0)
+#define NATIVE_WIDTH       (224)
+#define NATIVE_HEIGHT      (256)
+// Scenarios fan-out : maximum number of child processes
+#define MAX_SCENARIOS      (64)
+// Number of threads of the verilated model (set by compile.sh)
+#ifndef MODEL_THREADS
+#define MODEL_THREADS      (0)
+#endif /* MODEL_THREADS */
 
 int main(int argc, char **argv, char **env)
 {
+    // Clocks generation : like the other C++ models, it is only accessed from this
+    // thread, between two evaluations of the (possibly multi-threaded) verilated model
+    ClockGen *clk;
     // Simulation duration
-    time_t beg, end;
+    vluint64_t beg;
     double secs;
+#if VM_TRACE && !VM_TRACE_FST
+    // VCD flight recorder : frames kept, trigger port and value
+    int ring_frames;
+    const char *trig_name;
+    void *trig_port;
+    int trig_size;
+    vluint32_t trig_value;
+    bool trig_prev;
+    int sdr_errors;
+    const char *ring_pend;
+#endif /* VM_TRACE && !VM_TRACE_FST */
+    // Performance counters : split timing, report file
+    bool perf_on;
+    const char *perf_file;
+    int perf_warmup;
     // Trace index
     int trc_idx = 0;
     int min_idx = 0;
+    int max_idx = 0x7FFFFFFF;
+#if VM_TRACE
+    // Traced scopes (NULL : all)
+    const char *trc_scope;
+#endif /* VM_TRACE */
     // File name generation
     char file_name[256];
-    // Simulation steps
-    vluint64_t tb_sstep;
+    // Clock edges (toggled clocks, rising edges)
+    vluint32_t tb_edges;
+    vluint32_t tb_rises;
     // Simulation time
     vluint64_t tb_time;
     vluint64_t max_time;
     // Testbench configuration
     const char *arg;
+    // Preloaded SDRAM image
+    const char *sdram_img;
+    // SDRAM bandwidth profile
+    const char *sdram_prof;
+    // SDRAM access heatmap
+    const char *sdram_heat;
+    // SDRAM timings checker
+    bool sdram_tmg_on;
+    sdram_timing sdram_tmg;
+    // Frame hashes
+    const char *hash_log;
+    const char *golden;
+    int frame_err;
+    int frame_delta;
+    // Native resolution capture
+    int nat_cfg[6];
+    // Checkpoints : frame to save, file to restore
+    int frame_ctr;
+    int ckpt_frame;
+    const char *restore;
+    // Scenarios fan-out : frame to fork at, inputs of each child
+    int fork_frame;
+    int fork_jobs;
+    int scn_num;
+    int scn_err;
+    unsigned scn_inputs[MAX_SCENARIOS][4];
+    char scn_movie[MAX_SCENARIOS][256];
+    // Input movie : playback, recorder
+    const char *inputs;
+    const char *input_rec;
+    // Capture window : video clock stopped outside of it
+    int cap_beg;
+    int cap_end;
+    bool vid_off;
+    bool vid_resync;
+    vluint64_t vid_next_ps;
     // BUS_CLK counter
     vluint8_t bus_clk_ctr;
     // VID_CLK counter
@@ -64,7 +173,7 @@ int main(int argc, char **argv, char **env)
     // VS trigger
     vluint8_t vs;
 
-    beg = time(0);
+    beg = SimPerf::now_ns();
     
     // Parse parameters
     Verilated::commandArgs(argc, argv);
@@ -88,43 +197,276 @@ int main(int argc, char **argv, char **env)
         max_time = (vluint64_t)atoi(arg) * (vluint64_t)1000000000;
     }
     
-    // Trace start index : +tidx=<num>
+    // Trace frames window : +tidx=<first>[-<last>]
     arg = Verilated::commandArgsPlusMatch("tidx=");
     if ((arg) && (arg[0]))
     {
         arg += 6;
         min_idx = atoi(arg);
+        arg = strchr(arg, '-');
+        if (arg) max_idx = atoi(arg + 1);
+    }
+    else
+    {
+        min_idx = 0;
+    }
+    if (max_idx != 0x7FFFFFFF)
+        printf("+tidx=%d-%d\n", min_idx, max_idx);
+    else
+        printf("+tidx=%d\n", min_idx);
+    
+    // Preloaded SDRAM image : +sdram_img=<file>
+    arg = Verilated::commandArgsPlusMatch("sdram_img=");
+    if ((arg) && (arg[0]))
+    {
+        sdram_img = arg + 11;
     }
     else
+    {
+        sdram_img = (const char *)NULL;
+    }
+    
+    // SDRAM bandwidth profile : +sdram_prof=<file> (per-frame CSV, summary at the end)
+    arg = Verilated::commandArgsPlusMatch("sdram_prof=");
+    sdram_prof = ((arg) && (arg[0])) ? arg + 12 : (const char *)NULL;
+    
+    // SDRAM access heatmap : +sdram_heat=<prefix> (<prefix>_frames.csv, <prefix>_pages.csv)
+    arg = Verilated::commandArgsPlusMatch("sdram_heat=");
+    sdram_heat = ((arg) && (arg[0])) ? arg + 12 : (const char *)NULL;
+    
+    // SDRAM timings checker : +sdram_timing or +sdram_timing=<tRCD>,<tRP>,<tRAS>,<tRC>,<tWR>,<tRFC>,<tREFI>
+    arg = Verilated::commandArgsPlusMatch("sdram_timing");
+    sdram_tmg_on = ((arg) && (arg[0]) && ((arg[13] == 0) || (arg[13] == '=')));
+    sdram_tmg.rcd  = SDRAM_T_RCD;
+    sdram_tmg.rp   = SDRAM_T_RP;
+    sdram_tmg.ras  = SDRAM_T_RAS;
+    sdram_tmg.rc   = SDRAM_T_RC;
+    sdram_tmg.wr   = SDRAM_T_WR;
+    sdram_tmg.rfc  = SDRAM_T_RFC;
+    sdram_tmg.refi = SDRAM_T_REFI;
+    if ((sdram_tmg_on) && (arg[13] == '='))
+    {
+        sscanf(arg + 14, "%d,%d,%d,%d,%d,%d,%d", &sdram_tmg.rcd, &sdram_tmg.rp, &sdram_tmg.ras,
+               &sdram_tmg.rc, &sdram_tmg.wr, &sdram_tmg.rfc, &sdram_tmg.refi);
+    }
+    
+    // Frame hashes log : +hash_log=<file>
+    arg = Verilated::commandArgsPlusMatch("hash_log=");
+    hash_log = ((arg) && (arg[0])) ? arg + 10 : (const char *)NULL;
+    
+    // Golden frame hashes (stop on the first mismatch) : +golden=<file>
+    arg = Verilated::commandArgsPlusMatch("golden=");
+    golden = ((arg) && (arg[0])) ? arg + 8 : (const char *)NULL;
+    
+    // Save a checkpoint at the end of a frame : +checkpoint=<frame>
+    arg = Verilated::commandArgsPlusMatch("checkpoint=");
+    ckpt_frame = ((arg) && (arg[0])) ? atoi(arg + 12) : -1;
+    
+    // Resume from a checkpoint : +restore=<file>
+    arg = Verilated::commandArgsPlusMatch("restore=");
+    restore = ((arg) && (arg[0])) ? arg + 9 : (const char *)NULL;
+#if !VM_SAVABLE
+    if ((ckpt_frame >= 0) || (restore))
+    {
+        printf("Checkpoints are not supported : the model must be built with --savable (compile.sh)\n");
+        ckpt_frame = -1;
+        restore    = (const char *)NULL;
+    }
+#endif /* !VM_SAVABLE */
+    
+    // Scenarios fan-out : +fork=<frame> +scenarios=<file> [+jobs=<num>]
+    // One child process per line of the scenarios file, forked at the end of the
+    // frame, with its own inputs : <start_n> <coin_n> <joy1_n> <joy2_n> (hex)
+    // or input movie file
+    arg = Verilated::commandArgsPlusMatch("fork=");
+    fork_frame = ((arg) && (arg[0])) ? atoi(arg + 6) : -1;
+    scn_num    = 0;
+    scn_err    = 0;
+    if (fork_frame >= 0)
+    {
+        FILE *fh;
+        char  line[256];
+        int   scn_skip = 0;
+        
+        arg = Verilated::commandArgsPlusMatch("scenarios=");
+        fh  = ((arg) && (arg[0])) ? fopen(arg + 11, "r") : (FILE *)NULL;
+        if (fh)
+        {
+            while (fgets(line, sizeof(line), fh))
+            {
+                unsigned  dummy[4];
+                char      name[256];
+                unsigned *in  = (scn_num < MAX_SCENARIOS) ? scn_inputs[scn_num] : dummy;
+                char     *mov = (scn_num < MAX_SCENARIOS) ? scn_movie[scn_num]  : name;
+                
+                mov[0] = 0;
+                // Empty lines and comments are skipped
+                if ((sscanf(line, "%x %x %x %x", &in[0], &in[1], &in[2], &in[3]) == 4) ||
+                    (sscanf(line, " %255[^# \t\r\n]", mov) == 1))
+                {
+                    if (scn_num < MAX_SCENARIOS) scn_num++; else scn_skip++;
+                }
+            }
+            fclose(fh);
+            printf("%d scenarios forked at the end of frame #%d\n", scn_num, fork_frame);
+            if (scn_skip) printf("%d scenarios ignored (%d at most) !!\n", scn_skip, MAX_SCENARIOS);
+        }
+        else
+        {
+            printf("Cannot open the scenarios file (+scenarios=<file>) !!\n");
+            fork_frame = -1;
+        }
+#if MODEL_THREADS > 0
+        // The threads of the verilated model would not survive the fork
+        printf("Scenarios fan-out is not supported by multi-threaded models !!\n");
+        fork_frame = -1;
+#endif /* MODEL_THREADS > 0 */
+        arg = Verilated::commandArgsPlusMatch("jobs=");
+        fork_jobs = ((arg) && (arg[0])) ? atoi(arg + 6) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+        if (fork_jobs < 1) fork_jobs = 1;
+    }
+    
+    // Input movie playback : +inputs=<file>
+    arg = Verilated::commandArgsPlusMatch("inputs=");
+    inputs = ((arg) && (arg[0])) ? arg + 8 : (const char *)NULL;
+    
+    // Input movie recorder : +input_rec=<file>
+    arg = Verilated::commandArgsPlusMatch("input_rec=");
+    input_rec = ((arg) && (arg[0])) ? arg + 11 : (const char *)NULL;
+    
+#if VM_TRACE && !VM_TRACE_FST
+    // VCD flight recorder : +vcd_ring=<frames> [+vcd_trigger=<port>=<value>]
+    // The last frames are only written on a SDRAM error, on the port value or at the end
+    arg = Verilated::commandArgsPlusMatch("vcd_ring=");
+    ring_frames = ((arg) && (arg[0])) ? atoi(arg + 10) : 0;
+    arg = Verilated::commandArgsPlusMatch("vcd_trigger=");
+    trig_name = ((arg) && (arg[0]) && (ring_frames > 0)) ? arg + 13 : (const char *)NULL;
+    // The whole simulation is traced
+    if (ring_frames > 0)
     {
         min_idx = 0;
+        max_idx = 0x7FFFFFFF;
+    }
+#endif /* VM_TRACE && !VM_TRACE_FST */
+    
+#if VM_TRACE
+    // Traced scopes : +trace_scope=<scope>[,<scope>...] (paths below top_1943)
+    // Only the signals of these instances (and below) are dumped
+    arg = Verilated::commandArgsPlusMatch("trace_scope=");
+    trc_scope = ((arg) && (arg[0])) ? arg + 13 : (const char *)NULL;
+#endif /* VM_TRACE */
+    
+    // Performance counters : +perf or +perf=<file> (JSON if ".json", CSV otherwise)
+    arg = Verilated::commandArgsPlusMatch("perf");
+    perf_on   = ((arg) && (arg[0]) && ((arg[5] == 0) || (arg[5] == '=')));
+    perf_file = ((perf_on) && (arg[5] == '=')) ? arg + 6 : (const char *)NULL;
+    
+    // End-of-run report only : +perf_report=<file> (no split timing, real simulation speed)
+    arg = Verilated::commandArgsPlusMatch("perf_report=");
+    if ((arg) && (arg[0]) && (!perf_file)) perf_file = arg + 13;
+    
+    // Frames not measured by the performance counters : +warmup=<num>
+    arg = Verilated::commandArgsPlusMatch("warmup=");
+    perf_warmup = ((arg) && (arg[0])) ? atoi(arg + 8) : 0;
+    
+    // Capture window : +capture=<first frame>-<last frame>
+    // The video clock domain does not feed the game logic : it is stopped (and kept
+    // in reset) outside of the window, the frame ends are then predicted
+    arg = Verilated::commandArgsPlusMatch("capture=");
+    cap_beg = -1;
+    cap_end = 0x7FFFFFFF;
+    if ((arg) && (arg[0]))
+    {
+        if (sscanf(arg + 9, "%d-%d", &cap_beg, &cap_end) < 1) cap_beg = -1;
+        if (cap_beg >= 0) printf("Frames #%d - #%d captured\n", cap_beg, cap_end);
+    }
+    vid_off     = false;
+    vid_resync  = false;
+    vid_next_ps = (vluint64_t)0;
+    
+    // Native resolution capture : +native or +native=<hscale>x<vscale>,<hoffset>,<voffset>,<width>x<height>
+    arg = Verilated::commandArgsPlusMatch("native");
+    if ((arg) && (arg[0]))
+    {
+        nat_cfg[0] = NATIVE_HSCALE;
+        nat_cfg[1] = NATIVE_VSCALE;
+        nat_cfg[2] = NATIVE_HOFFSET;
+        nat_cfg[3] = NATIVE_VOFFSET;
+        nat_cfg[4] = NATIVE_WIDTH;
+        nat_cfg[5] = NATIVE_HEIGHT;
+        if (arg[7] == '=')
+        {
+            sscanf(arg + 8, "%dx%d,%d,%d,%dx%d", &nat_cfg[0], &nat_cfg[1], &nat_cfg[2],
+                                                 &nat_cfg[3], &nat_cfg[4], &nat_cfg[5]);
+        }
+    }
+    else
+    {
+        nat_cfg[0] = 0;
     }
-    printf("+tidx=%d\n", min_idx);
 
     // Init top verilog instance
     Vtop_1943* top = new Vtop_1943;
+#if MODEL_THREADS > 0
+    printf("Multi-threaded verilated model (%d threads)\n", MODEL_THREADS);
+#endif /* MODEL_THREADS > 0 */
     
     // Init SDRAM C++ model (4096 rows, 512 cols)
-    sdram_flags = FLAG_DATA_WIDTH_16; // | FLAG_BANK_INTERLEAVING | FLAG_BIG_ENDIAN;
-    SDRAM* sdr  = new SDRAM(SDRAM_BIT_ROWS, SDRAM_BIT_COLS, sdram_flags, NULL);
-    // Load main program (32 kB + 128 KB)
-    sdr->load("1943.01",  0x08000, 0x000000);
-    sdr->load("1943.02",  0x10000, 0x020000);
-    sdr->load("1943.03",  0x10000, 0x030000);
-    // Load sprite graphics (256 KB)
-    sdr->load("1943.spr", 0x40000, 0x400000);
-    // Load background tiles (32 KB)
-    sdr->load("1943.23",  0x08000, 0xC00000);
-    // Load foreground tiles (32 KB)
-    sdr->load("1943.14",  0x08000, 0xC08000);
-    // Load characters (64 KB)
-    sdr->load("1943.chr", 0x10000, 0xC10000);
-    // Load background graphics (64 KB)
-    sdr->load("1943.bgn", 0x10000, 0xD00000);
-    // Load foreground graphics (256 KB)
-    sdr->load("1943.fgn", 0x40000, 0xD80000);
+    sdram_flags = FLAG_DATA_WIDTH_16 | FLAG_WORD_STORAGE; // | FLAG_BANK_INTERLEAVING | FLAG_BIG_ENDIAN;
+    SDRAM* sdr  = new SDRAM(SDRAM_BIT_ROWS, SDRAM_BIT_COLS, sdram_flags, NULL, sdram_img);
+    if (sdram_prof) sdr->set_profile(sdram_prof, SDRAM_LINE_CYCLES, SDRAM_LINE_SLOTS);
+    if (sdram_heat)
+    {
+        // ROM regions (same layout as below)
+        sdr->add_region("program",  0x000000, 0x040000);
+        sdr->add_region("sprites",  0x400000, 0x040000);
+        sdr->add_region("bg_tiles", 0xC00000, 0x008000);
+        sdr->add_region("fg_tiles", 0xC08000, 0x008000);
+        sdr->add_region("chars",    0xC10000, 0x010000);
+        sdr->add_region("bg_gfx",   0xD00000, 0x010000);
+        sdr->add_region("fg_gfx",   0xD80000, 0x040000);
+        sdr->set_heatmap(sdram_heat, SDRAM_HEAT_PAGE);
+    }
+    if (sdram_tmg_on) sdr->set_timing(&sdram_tmg);
+    // The ROM files are only loaded when there is no valid SDRAM image (or checkpoint)
+    if ((!sdr->image_mapped()) && (!restore))
+    {
+        // Load main program (32 kB + 128 KB)
+        sdr->load("1943.01",  0x08000, 0x000000);
+        sdr->load("1943.02",  0x10000, 0x020000);
+        sdr->load("1943.03",  0x10000, 0x030000);
+        // Load sprite graphics (256 KB)
+        sdr->load("1943.spr", 0x40000, 0x400000);
+        // Load background tiles (32 KB)
+        sdr->load("1943.23",  0x08000, 0xC00000);
+        // Load foreground tiles (32 KB)
+        sdr->load("1943.14",  0x08000, 0xC08000);
+        // Load characters (64 KB)
+        sdr->load("1943.chr", 0x10000, 0xC10000);
+        // Load background graphics (64 KB)
+        sdr->load("1943.bgn", 0x10000, 0xD00000);
+        // Load foreground graphics (256 KB)
+        sdr->load("1943.fgn", 0x40000, 0xD80000);
+        // Save the SDRAM image for the next runs
+        if (sdram_img) sdr->save_image(sdram_img);
+    }
+    // Init players inputs
+    InputMovie* movie = new InputMovie();
+    if (inputs) movie->load(inputs);
+    if (input_rec) movie->record(input_rec);
     // Init VGA output C++ model
     VideoOut* vga = new VideoOut(0, 4, 0, 0, 1280, 0, 1024, "snapshot");
+    // Decimate the upscaled frames, check the replicated pixels with +check_rep
+    if (nat_cfg[0])
+    {
+        arg = Verilated::commandArgsPlusMatch("check_rep");
+        vga->set_native(nat_cfg[0], nat_cfg[1], nat_cfg[2], nat_cfg[3], nat_cfg[4], nat_cfg[5],
+                        (arg) && (arg[0]));
+    }
+    // Save the BMP files in the background
+    vga->set_async(true);
+    // Only save the frames that differ from the golden ones
+    if ((hash_log) || (golden)) vga->set_hash_mode(hash_log, golden);
     
     // Initialize clock generator    
     clk = new ClockGen(2, max_time);
@@ -134,110 +476,439 @@ int main(int argc, char **argv, char **env)
     // 108 MHz clock
     clk->NewClock(1, PERIOD_108MHz_ps, 0);
     clk->StartClock(1);
+    // Replay the precomputed edges sequence
+    clk->SetTimelineMode(true);
+    
+    frame_ctr = 0;
+    sdram_q   = (vluint64_t)0;
+#if VM_SAVABLE
+    // Restore the whole simulation state
+    if (restore)
+    {
+        VerilatedRestore is;
+        
+        is.open(restore);
+        if (!is.isOpen())
+        {
+            printf("Cannot open checkpoint file \"%s\" !!\n", restore);
+            exit(1);
+        }
+        is >> *top;
+        if ((!clk->RestoreState(is)) || (!sdr->restore_state(is)) || (!vga->restore_state(is)))
+        {
+            exit(1);
+        }
+        is.read((void *)&sdram_q,   sizeof(sdram_q));
+        is.read((void *)&frame_ctr, sizeof(frame_ctr));
+        is.read((void *)&trc_idx,   sizeof(trc_idx));
+        is.read((void *)&vid_off,     sizeof(vid_off));
+        is.read((void *)&vid_resync,  sizeof(vid_resync));
+        is.read((void *)&vid_next_ps, sizeof(vid_next_ps));
+        is.close();
+        // The checkpoint was saved at the end of this frame
+        frame_ctr++;
+        printf("Simulation restored from checkpoint \"%s\" (frame #%d, %llu ps)\n",
+               restore, frame_ctr - 1, clk->GetTimeStampPs());
+    }
+#endif /* VM_SAVABLE */
   
 #if VM_TRACE
-    // Init VCD trace dump
+    // Init VCD/FST trace dump
     Verilated::traceEverOn(true);
-    VerilatedVcdC* tfp = new VerilatedVcdC;
+#if VM_TRACE_FST
+    TRACE_CLASS* tfp = new TRACE_CLASS;
+#else
+    VcdRing* ring = (ring_frames > 0) ? new VcdRing(ring_frames) : (VcdRing *)NULL;
+    TRACE_CLASS* tfp = (ring) ? new TRACE_CLASS(ring) : new TRACE_CLASS;
+#endif /* VM_TRACE_FST */
     top->trace (tfp, 99);
+    // Selected scopes (before the first open) : the other signals are never dumped
+    for (const char *scp = trc_scope; (scp) && (scp[0]); )
+    {
+        const char *end = strchr(scp, ',');
+        int len = (end) ? (int)(end - scp) : (int)strlen(scp);
+        
+        if (len) tfp->dumpvars(99, std::string("TOP.top_1943.") + std::string(scp, len));
+        scp += (end) ? len + 1 : len;
+    }
     tfp->spTrace()->set_time_resolution ("1 ps");
     if (trc_idx == min_idx)
     {
-        sprintf(file_name, "gpu_%04d.vcd", trc_idx);
+        sprintf(file_name, "gpu_%04d." TRACE_EXT, trc_idx);
         tfp->open (file_name);
     }
 #endif /* VM_TRACE */
+    
+#if VM_TRACE && !VM_TRACE_FST
+    // Flight recorder trigger : top level port
+    trig_port  = (void *)NULL;
+    trig_size  = 0;
+    trig_value = (vluint32_t)0;
+    trig_prev  = false;
+    sdr_errors = 0;
+    ring_pend  = (const char *)NULL;
+    if (trig_name)
+    {
+        #define TRIG_PORT(p) if (!strncmp(trig_name, #p "=", strlen(#p) + 1)) \
+                             { trig_port = (void *)&top->p; trig_size = (int)sizeof(top->p); }
+        TRIG_PORT(start_n)     TRIG_PORT(coin_n)      TRIG_PORT(joy1_n)      TRIG_PORT(joy2_n)
+        TRIG_PORT(sdram_cs_n)  TRIG_PORT(sdram_ras_n) TRIG_PORT(sdram_cas_n) TRIG_PORT(sdram_we_n)
+        TRIG_PORT(sdram_ba)    TRIG_PORT(sdram_addr)  TRIG_PORT(sdram_dqm_n) TRIG_PORT(sdram_dq_oe)
+        TRIG_PORT(sdram_dq_o)  TRIG_PORT(vga_hs)      TRIG_PORT(vga_vs)      TRIG_PORT(vga_de)
+        TRIG_PORT(vga_r)       TRIG_PORT(vga_g)       TRIG_PORT(vga_b)
+        #undef TRIG_PORT
+        if (trig_port)
+        {
+            trig_value = (vluint32_t)strtoul(strchr(trig_name, '=') + 1, NULL, 0);
+            printf("VCD flight recorder : trigger on %s\n", trig_name);
+        }
+        else
+        {
+            printf("Unknown top level port for the VCD trigger (%s) !!\n", trig_name);
+        }
+    }
+#endif /* VM_TRACE && !VM_TRACE_FST */
   
-    // Initialize simulation inputs
-    top->bus_rst = 1;
-    top->bus_clk = 0;
-    top->vid_rst = 1;
-    top->vid_clk = 0;
-    
-    top->start_n = 0x03;
-    top->coin_n  = 0x03;
-    top->joy1_n  = 0x3F;
-    top->joy2_n  = 0x3F;
+    // Restored model : already out of reset
+    if (!restore)
+    {
+        // Initialize simulation inputs
+        top->bus_rst = 1;
+        top->bus_clk = 0;
+        top->vid_rst = 1;
+        top->vid_clk = 0;
+    
+        top->start_n = 0x03;
+        top->coin_n  = 0x03;
+        top->joy1_n  = 0x3F;
+        top->joy2_n  = 0x3F;
   
-    tb_sstep     = (vluint64_t)0;
-    tb_time      = (vluint64_t)0;
+        tb_time      = (vluint64_t)0;
     
-    // Reset ON during 8 bus cycles / 12 video cycles
-    for (int i = 0; i < 32; i ++)
-    {
-        // Toggle clock
-        clk->AdvanceClocks();
-        top->bus_clk = clk->GetClockStateDiv1(0, 0);
-        top->vid_clk = clk->GetClockStateDiv1(1, 0);
-        // Evaluate verilated model
-        top->eval ();
-#if VM_TRACE
-        // Dump signals into VCD file
-        if (tfp)
+        // Reset ON during 8 bus cycles / 12 video cycles
+        for (int i = 0; i < 32; i ++)
         {
-            if (trc_idx >= min_idx)
+            // Toggle clock
+            clk->AdvanceClocks();
+            tb_time = clk->GetTimeStampPs();
+            top->bus_clk = clk->GetClockStateDiv1(0, 0);
+            top->vid_clk = clk->GetClockStateDiv1(1, 0);
+            // Evaluate verilated model
+            top->eval ();
+#if VM_TRACE
+            // Dump signals into VCD file
+            if (tfp)
             {
-                tfp->dump (tb_time);
+                if (trc_idx >= min_idx)
+                {
+                    tfp->dump (tb_time);
+                }
             }
-        }
 #endif /* VM_TRACE */
+        }
+        top->bus_rst = 0;
+        top->vid_rst = 0;
     }
-    top->bus_rst = 0;
-    top->vid_rst = 0;
+    // Native resolution capture : Scale2X and scanlines off (reset value : vertical
+    // scanlines on), each 4 x 4 block is then one replicated pixel
+    if (nat_cfg[0]) top->rootp->top_1943__DOT__U_gpu_top__DOT__U_gpu_gpios__DOT__r_cfg_reg = 0;
+    movie->apply(frame_ctr, top->start_n, top->coin_n, top->joy1_n, top->joy2_n);
+    // Capture window : the frames before it are not saved
+    if (cap_beg >= 0) vga->set_capture((frame_ctr >= cap_beg) && (frame_ctr <= cap_end));
   
+    // Wall time split between the models with +perf
+    SimPerf* perf = new SimPerf(perf_on, clk->GetTimeStampPs());
+    
     // Simulation loop
     while (!clk->EndOfSimulation())
     {
         // Toggle clock
         clk->AdvanceClocks();
+        tb_time  = clk->GetTimeStampPs();
+        tb_edges = clk->GetEdgeMask();
         top->bus_clk = clk->GetClockStateDiv1(0, 0);
         top->vid_clk = clk->GetClockStateDiv1(1, 0);
-        // Evaluate verilated model
+        tb_rises = tb_edges & ((vluint32_t)top->bus_clk | ((vluint32_t)top->vid_clk << 1));
+        perf->step(tb_edges, tb_rises);
+        
+        // Evaluate verilated model : at every edge (one call when both clocks toggle),
+        // the posedges are detected against the clock values of the previous evaluation
+        perf->begin();
         top->eval ();
+        perf->eval();
+        perf->end(PERF_EVAL);
         
-        // Evaluate SDRAM C++ model
-        sdr->eval (tb_sstep / 6,
-                   top->bus_clk ^ 1, 1,
-                   top->sdram_cs_n,  top->sdram_ras_n, top->sdram_cas_n, top->sdram_we_n,
-                   top->sdram_ba,    top->sdram_addr,
-                   top->sdram_dqm_n, (vluint64_t)top->sdram_dq_o,  sdram_q);
+        // Evaluate SDRAM C++ model (bus clock falling edge)
+        if ((tb_edges & BUS_CLK_EDGE) && (!top->bus_clk))
+        {
+            perf->begin();
+            sdr->eval_posedge (tb_time,
+                               top->sdram_cs_n,  top->sdram_ras_n, top->sdram_cas_n, top->sdram_we_n,
+                               top->sdram_ba,    top->sdram_addr,
+                               top->sdram_dqm_n, (vluint64_t)top->sdram_dq_o,  sdram_q);
+            perf->end(PERF_SDRAM);
+        }
         // "Read" from SDRAM
         top->sdram_dq_i = (top->sdram_dq_oe) ? top->sdram_dq_o : (vluint16_t)sdram_q;
         
-        // Dump VGA output
-        vs = vga->eval_RGB444_DE (tb_sstep / 4,
-                                  top->vid_clk,
-                                  top->vga_de,
-                                  top->vga_r,  top->vga_g,  top->vga_b);
+        // Dump VGA output (video clock rising edge)
+        if (tb_rises & VID_CLK_EDGE)
+        {
+            perf->begin();
+            vs = vga->eval_RGB444_DE_posedge (tb_time / PERIOD_108MHz_ps,
+                                              top->vga_de,
+                                              top->vga_r,  top->vga_g,  top->vga_b);
+            perf->end(PERF_VIDEO);
+        }
+        else
+        {
+            vs = (vluint8_t)0;
+        }
+        
+        // Video clock stopped : predicted end of frame, until the video output is synchronized again
+        if ((vid_off) || (vid_resync))
+        {
+            if ((vid_resync) && ((vga->get_hcount()) || (vga->get_vcount())))
+            {
+                vid_resync = false;
+            }
+            else if (tb_time >= vid_next_ps)
+            {
+                vs = vga->skip_frame();
+                vid_next_ps += FRAME_PERIOD_ps;
+            }
+        }
                                 
 #if VM_TRACE
-        // Dump signals into VCD file
+        // Dump signals into VCD/FST file
         if (tfp)
         {
+            perf->begin();
             if (vs)
             {
-                // New VCD file
-                if (trc_idx >= min_idx) tfp->close();
+                // New VCD/FST file
+                if ((trc_idx >= min_idx) && (trc_idx <= max_idx)) tfp->close();
 				trc_idx++;
-				if (trc_idx >= min_idx)
+				if ((trc_idx >= min_idx) && (trc_idx <= max_idx))
 				{
-                    sprintf(file_name, "gpu_%04d.vcd", trc_idx);
+                    sprintf(file_name, "gpu_%04d." TRACE_EXT, trc_idx);
                     tfp->open (file_name);
 				}
             }
-            if (trc_idx >= min_idx)
+            if ((trc_idx >= min_idx) && (trc_idx <= max_idx))
             {
                 tfp->dump (tb_time);
             }
+            perf->end(PERF_TRACE);
+        }
+#endif /* VM_TRACE */
+        
+#if VM_TRACE && !VM_TRACE_FST
+        // Flight recorder triggers : new SDRAM protocol error, port reaching its value
+        // The ring is written at the end of the frame (once, whatever the number of triggers)
+        if (ring)
+        {
+            bool trig_curr = false;
+            
+            if (sdr->get_errors() != sdr_errors)
+            {
+                sdr_errors = sdr->get_errors();
+                if (!ring_pend) ring_pend = "SDRAM error";
+            }
+            if (trig_port)
+            {
+                switch (trig_size)
+                {
+                    case 1  : trig_curr = (*(vluint8_t  *)trig_port == trig_value); break;
+                    case 2  : trig_curr = (*(vluint16_t *)trig_port == trig_value); break;
+                    default : trig_curr = (*(vluint32_t *)trig_port == trig_value);
+                }
+                if ((trig_curr) && (!trig_prev) && (!ring_pend)) ring_pend = trig_name;
+                trig_prev = trig_curr;
+            }
+            if ((vs) && (ring_pend))
+            {
+                tfp->flush();
+                ring->dump(ring_pend);
+                ring_pend = (const char *)NULL;
+            }
         }
+#endif /* VM_TRACE && !VM_TRACE_FST */
+        
+        // Golden frame mismatch : stop right away
+        if ((vs) && (vga->get_mismatch() >= 0)) break;
+        
+        if (vs)
+        {
+            // Native resolution capture : forced again (Z80 write to the GPU config)
+            if (nat_cfg[0]) top->rootp->top_1943__DOT__U_gpu_top__DOT__U_gpu_gpios__DOT__r_cfg_reg = 0;
+            perf->frame(frame_ctr, tb_time, perf_on);
+            sdr->prof_frame(frame_ctr);
+            sdr->heat_frame(frame_ctr);
+#if VM_SAVABLE
+            // Save the whole simulation state
+            if (frame_ctr == ckpt_frame)
+            {
+                VerilatedSave os;
+                
+                sprintf(file_name, "checkpoint_%04d.bin", frame_ctr);
+                os.open(file_name);
+                os << *top;
+                clk->SaveState(os);
+                sdr->save_state(os);
+                vga->save_state(os);
+                os.write((void *)&sdram_q,   sizeof(sdram_q));
+                os.write((void *)&frame_ctr, sizeof(frame_ctr));
+                os.write((void *)&trc_idx,   sizeof(trc_idx));
+                os.write((void *)&vid_off,     sizeof(vid_off));
+                os.write((void *)&vid_resync,  sizeof(vid_resync));
+                os.write((void *)&vid_next_ps, sizeof(vid_next_ps));
+                os.close();
+                printf(" Checkpoint saved in file \"%s\"\n", file_name);
+            }
+#endif /* VM_SAVABLE */
+            // Scenarios fan-out : the children share the warm state (copy-on-write)
+            if (frame_ctr == fork_frame)
+            {
+                int running = 0;
+                int status;
+                
+                // Nothing pending may be inherited by the children
+                vga->set_async(false);
+#if VM_TRACE
+                if ((tfp) && (trc_idx >= min_idx) && (trc_idx <= max_idx)) tfp->close();
 #endif /* VM_TRACE */
+                fflush(NULL);
+                
+                for (int i = 0; i < scn_num; i++)
+                {
+                    pid_t pid;
+                    
+                    // Limit the number of children running at once
+                    if (running == fork_jobs)
+                    {
+                        if ((wait(&status) > 0) && ((!WIFEXITED(status)) || (WEXITSTATUS(status)))) scn_err++;
+                        running--;
+                    }
+                    
+                    pid = fork();
+                    if (pid == 0)
+                    {
+                        // Child : inputs from an input movie or constant
+                        if (scn_movie[i][0])
+                        {
+                            if (!movie->load(scn_movie[i])) exit(1);
+                        }
+                        else
+                        {
+                            movie->clear();
+                            top->start_n = (vluint8_t)scn_inputs[i][0];
+                            top->coin_n  = (vluint8_t)scn_inputs[i][1];
+                            top->joy1_n  = (vluint8_t)scn_inputs[i][2];
+                            top->joy2_n  = (vluint8_t)scn_inputs[i][3];
+                        }
+                        // Child : files are written into its own directory
+                        sprintf(file_name, "scenario_%02d", i);
+                        mkdir(file_name, 0755);
+                        if (chdir(file_name))
+                        {
+                            printf("Cannot enter directory \"%s\" !!\n", file_name);
+                            exit(1);
+                        }
+                        if (input_rec) movie->record(input_rec);
+                        sdr->fork_trace(i);
+                        if (hash_log) vga->set_hash_mode(hash_log, (const char *)NULL);
+                        if (sdram_prof) sdr->set_profile(sdram_prof, SDRAM_LINE_CYCLES, SDRAM_LINE_SLOTS);
+                        if (sdram_heat) sdr->set_heatmap(sdram_heat, SDRAM_HEAT_PAGE);
+                        vga->set_async(true);
+#if VM_TRACE
+                        if ((tfp) && (trc_idx >= min_idx) && (trc_idx <= max_idx))
+                        {
+                            sprintf(file_name, "gpu_%04d." TRACE_EXT, trc_idx);
+                            tfp->open (file_name);
+                        }
+#endif /* VM_TRACE */
+                        fork_frame = -1;
+                        break;
+                    }
+                    else if (pid > 0)
+                    {
+                        running++;
+                    }
+                    else
+                    {
+                        printf("Cannot fork scenario #%d !!\n", i);
+                        scn_err++;
+                    }
+                }
+                
+                // Parent : wait for all the children
+                if (fork_frame >= 0)
+                {
+                    while (wait(&status) > 0)
+                    {
+                        if ((!WIFEXITED(status)) || (WEXITSTATUS(status))) scn_err++;
+                    }
+                    printf("%d scenarios done, %d failed\n", scn_num, scn_err);
+                    break;
+                }
+            }
+            frame_ctr++;
+            if (frame_ctr == perf_warmup) perf->restart(tb_time);
+            
+            // Players inputs of the next frame
+            movie->apply(frame_ctr, top->start_n, top->coin_n, top->joy1_n, top->joy2_n);
+            
+            // Capture window : the video clock runs from CAPTURE_LEAD frames before it,
+            // only the frames of the window are saved (video clock stopped in a restored
+            // checkpoint and no window : restarted)
+            if ((cap_beg >= 0) || (vid_off))
+            {
+                bool in_window = (cap_beg < 0) ||
+                                 ((frame_ctr + CAPTURE_LEAD >= cap_beg) && (frame_ctr <= cap_end));
+                
+                if (cap_beg >= 0) vga->set_capture((frame_ctr >= cap_beg) && (frame_ctr <= cap_end));
+                
+                // Real end of frame : next ones predicted from it
+                if ((!vid_off) && (!vid_resync)) vid_next_ps = tb_time + FRAME_PERIOD_ps;
+                
+                if ((!vid_off) && (!in_window))
+                {
+                    clk->StopClock(1);
+                    top->vid_rst = 1;
+                    vid_off      = true;
+                    vid_resync   = false;
+                }
+                else if ((vid_off) && (in_window))
+                {
+                    // Same edges as a never stopped clock, the video timing relocks on the next frame
+                    clk->StartClock(1, (PERIOD_108MHz_ps - tb_time % PERIOD_108MHz_ps) % PERIOD_108MHz_ps);
+                    top->vid_rst = 0;
+                    vga->resync();
+                    vid_off      = false;
+                    vid_resync   = true;
+                }
+            }
+        }
         
         if (Verilated::gotFinish()) break;
     }
 
 #if VM_TRACE
-    if (tfp && trc_idx >= min_idx) tfp->close();
+    if (tfp && trc_idx >= min_idx && trc_idx <= max_idx) tfp->close();
 #endif /* VM_TRACE */
+#if VM_TRACE && !VM_TRACE_FST
+    // Flight recorder : last frames of the simulation
+    if (ring)
+    {
+        ring->dump((ring_pend) ? ring_pend : "end of simulation");
+        delete tfp;
+        delete ring;
+    }
+#endif /* VM_TRACE && !VM_TRACE_FST */
+    
+    perf->report(perf_file, tb_time);
+    delete perf;
     
     top->final();
     
@@ -245,14 +916,34 @@ int main(int argc, char **argv, char **env)
     
     delete sdr;
     
+    frame_err   = vga->get_mismatch();
+    frame_delta = vga->get_golden_delta();
     delete vga;
     
     delete clk;
     
+    delete movie;
+    
     // Calculate running time
-    end = time(0);
-    secs = difftime(end, beg);
+    secs = (double)(SimPerf::now_ns() - beg) * 1e-9;
     printf("\nSeconds elapsed : %f\n", secs);
     
+    // Regression result
+    if (frame_err >= 0)
+    {
+        printf("Frame #%d differs from the golden frame !!\n", frame_err);
+        exit(1);
+    }
+    if (frame_delta > 0)
+    {
+        printf("%d frame(s) simulated past the end of the golden frames !!\n", frame_delta);
+        exit(1);
+    }
+    if (frame_delta < 0)
+    {
+        printf("%d golden frame(s) not simulated !!\n", -frame_delta);
+        exit(1);
+    }
+    if (scn_err) exit(1);
     exit(0);
 }
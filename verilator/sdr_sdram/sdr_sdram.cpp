@@ -34,7 +34,12 @@
 #include "sdr_sdram.h"
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 // SDRAM commands
 #define CMD_LMR  ((vluint8_t)0)
@@ -46,13 +51,30 @@
 #define CMD_BST  ((vluint8_t)6)
 #define CMD_NOP  ((vluint8_t)7)
 
+// Timing checker : no event yet
+#define TMG_NONE (~(vluint64_t)0)
+
+// Timing checker : parameter names
+static const char *tmg_name[TMG_NUM] = { "tRCD", "tRP", "tRAS", "tRC", "tWR", "tRFC", "tREFI" };
+
 // Data lanes
 #define DATA_MSB ((vluint8_t)0x01)
 #define DATA_MSW ((vluint8_t)0x02)
 #define DATA_MSL ((vluint8_t)0x04)
 
+// Native word for each data bus width (word-wide storage)
+template <int BUS_LOG2> struct sdram_word            { typedef vluint64_t type; };
+template <>             struct sdram_word<0>         { typedef vluint8_t  type; };
+template <>             struct sdram_word<1>         { typedef vluint16_t type; };
+template <>             struct sdram_word<2>         { typedef vluint32_t type; };
+
+// Preloaded image file
+#define SDRAM_IMAGE_MAGIC    "SDRIMG02"
+#define SDRAM_IMAGE_HDR_SIZE (65536) // Data offset (multiple of the page size)
+#define SDRAM_IMAGE_FLAGS    (DATA_MSB | DATA_MSW | DATA_MSL | FLAG_BANK_INTERLEAVING | FLAG_BIG_ENDIAN | FLAG_WORD_STORAGE)
+
 // Constructor
-SDRAM::SDRAM(vluint8_t log2_rows, vluint8_t log2_cols, vluint8_t flags, char *logfile)
+SDRAM::SDRAM(vluint8_t log2_rows, vluint8_t log2_cols, vluint8_t flags, char *logfile, const char *image)
 {
     // memory size
     int s       = (int)1 << (log2_rows + log2_cols);
@@ -122,34 +144,73 @@ SDRAM::SDRAM(vluint8_t log2_rows, vluint8_t log2_cols, vluint8_t flags, char *lo
         case 0x1E : read_byte_priv = &SDRAM::read_byte_i_be_64; break;
         case 0x1F : read_byte_priv = &SDRAM::read_byte_i_be_64; break;
     }
-    
-    // debug mode
-    if (logfile)
+    // word-wide storage : endianness handled with a byte lane swap
+    if (flags & FLAG_WORD_STORAGE)
     {
-        fh_log   = fopen(logfile, "w");
-        log_buf  = new char[2048];
-        log_size = 0;
-        if ((fh_log) && (log_buf))
-        {
-            printf("SDRAM log file \"%s\" created\n", logfile);
-            dbg_on = 1;
-        }
+        if (flags & FLAG_BANK_INTERLEAVING)
+            read_byte_priv = &SDRAM::read_byte_i_w;
         else
-        {
-            dbg_on = 0;
-        }
+            read_byte_priv = &SDRAM::read_byte_c_w;
     }
-    else
+    lane_swap   = (flags & FLAG_BIG_ENDIAN) ? bus_mask : 0;
+    // DQM to data bus mask (only the bytes present on the data bus)
+    for (int i = 0; i < 256; i++)
     {
-        fh_log   = (FILE *)NULL;
-        log_buf  = (char *)NULL;
-        log_size = 0;
-        dbg_on   = 0;
+        dqm_mask[i] = (vluint64_t)0;
+        for (int k = 0; k <= bus_mask; k++)
+        {
+            if (!(i & (1 << k))) dqm_mask[i] |= (vluint64_t)0xFF << (k << 3);
+        }
     }
     
+    // protocol errors counter
+    err_cnt  = 0;
+    
     // special flags
     mem_flags   = flags;
     
+    // debug mode : binary trace file
+    trc_buf  = (sdram_trace_rec *)NULL;
+    trc_cnt  = 0;
+    dbg_on   = 0;
+    fh_log   = (FILE *)NULL;
+    trc_name[0] = 0;
+    if ((logfile) && (trace_open(logfile)))
+    {
+        strncpy(trc_name, logfile, sizeof(trc_name) - 1);
+        trc_name[sizeof(trc_name) - 1] = 0;
+        trc_buf  = new sdram_trace_rec[TRACE_BUF_SIZE];
+        dbg_on   = 1;
+    }
+    
+    // bandwidth profiler and heatmap : off
+    fh_prof     = (FILE *)NULL;
+    prf_line_cyc   = 0x7FFFFFFF;
+    prf_line_slots = 1;
+    prf_cyc_ctr    = 0;
+    prf_ref_gap    = 0x7FFFFFFF;
+    for (int i = 0; i < SDRAM_NUM_BANKS; i++)
+    {
+        prf_line_acc[i] = 0;
+        prf_used[i]     = false;
+    }
+    memset((void *)&prf_frame, 0, sizeof(prf_frame));
+    memset((void *)&prf_total, 0, sizeof(prf_total));
+    memset((void *)prf_hist, 0, sizeof(prf_hist));
+    heat_on     = false;
+    fh_heat     = (FILE *)NULL;
+    heat_rd     = heat_wr     = (vluint32_t *)NULL;
+    heat_rd_tot = heat_wr_tot = (vluint64_t *)NULL;
+    heat_reg_cnt = 0;
+    tmg_on      = false;
+    tmg_cyc     = (vluint64_t)0;
+    tmg_ts      = (vluint64_t)0;
+    tmg_late    = TMG_NONE;
+    for (int i = 0; i < TMG_NUM; i++) tmg_min[i] = 0;
+    
+    // cycle evaluate kernel
+    select_kernel();
+    
     // mode register cleared
     cas_lat     = 0;
     bst_len_rd  = (int)0;
@@ -181,226 +242,1059 @@ SDRAM::SDRAM(vluint8_t log2_rows, vluint8_t log2_cols, vluint8_t flags, char *lo
     bst_ctr_rd  = (int)0;
     bst_ctr_wr  = (int)0;
 
-    // one array per byte lane and per bank (up to 16 arrays)
+    // one array per byte lane and per bank (up to 32 arrays) in a single memory block
+    mem_blk_size = (size_t)s * SDRAM_NUM_BANKS * (bus_mask + 1);
+    mem_blk      = (vluint8_t *)NULL;
+    mem_mapped   = false;
+    img_src_cnt  = 0;
+    
+    // preloaded image : private mapping (copy-on-write)
+    if (image) mem_mapped = map_image(image);
+    
+    if (!mem_mapped)
+    {
+        // anonymous mapping : the arrays are cleared on demand
+        mem_blk = (vluint8_t *)mmap(NULL, mem_blk_size, PROT_READ | PROT_WRITE,
+                                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mem_blk == (vluint8_t *)MAP_FAILED)
+        {
+            printf("Cannot allocate %d MB for the SDRAM arrays !!\n", (int)(mem_blk_size >> 20));
+            exit(1);
+        }
+        
+        if (flags & FLAG_RANDOM_FILLED)
+        {
+            // fill the arrays with random numbers
+            srand (time (NULL));
+            for (size_t j = 0; j < mem_blk_size; j++)
+            {
+                mem_blk[j] = (vluint8_t)rand() & 0xFF;
+            }
+        }
+    }
+    
     for (int i = 0; i < SDRAM_NUM_BANKS; i++)
     {
-                              mem_array_0[i] = new vluint8_t[s];
-        if (flags & DATA_MSB) mem_array_1[i] = new vluint8_t[s];
-        if (flags & DATA_MSW) mem_array_2[i] = new vluint8_t[s];
-        if (flags & DATA_MSW) mem_array_3[i] = new vluint8_t[s];
-        if (flags & DATA_MSL) mem_array_4[i] = new vluint8_t[s];
-        if (flags & DATA_MSL) mem_array_5[i] = new vluint8_t[s];
-        if (flags & DATA_MSL) mem_array_6[i] = new vluint8_t[s];
-        if (flags & DATA_MSL) mem_array_7[i] = new vluint8_t[s];
+        mem_array_7[i] = mem_array_6[i] = mem_array_5[i] = mem_array_4[i] = (vluint8_t *)NULL;
+        mem_array_3[i] = mem_array_2[i] = mem_array_1[i] = (vluint8_t *)NULL;
+        // word-wide storage : one array of words per bank
+        if (flags & FLAG_WORD_STORAGE)
+        {
+            mem_bank[i]    = mem_blk + ((size_t)s << bus_log2) * i;
+            mem_array_0[i] = (vluint8_t *)NULL;
+            continue;
+        }
+        mem_bank[i]    = (vluint8_t *)NULL;
+                              mem_array_0[i] = mem_blk + (size_t)s * (SDRAM_NUM_BANKS * 0 + i);
+        if (flags & DATA_MSB) mem_array_1[i] = mem_blk + (size_t)s * (SDRAM_NUM_BANKS * 1 + i);
+        if (flags & DATA_MSW) mem_array_2[i] = mem_blk + (size_t)s * (SDRAM_NUM_BANKS * 2 + i);
+        if (flags & DATA_MSW) mem_array_3[i] = mem_blk + (size_t)s * (SDRAM_NUM_BANKS * 3 + i);
+        if (flags & DATA_MSL) mem_array_4[i] = mem_blk + (size_t)s * (SDRAM_NUM_BANKS * 4 + i);
+        if (flags & DATA_MSL) mem_array_5[i] = mem_blk + (size_t)s * (SDRAM_NUM_BANKS * 5 + i);
+        if (flags & DATA_MSL) mem_array_6[i] = mem_blk + (size_t)s * (SDRAM_NUM_BANKS * 6 + i);
+        if (flags & DATA_MSL) mem_array_7[i] = mem_blk + (size_t)s * (SDRAM_NUM_BANKS * 7 + i);
+    }
+}
+
+// Cycle evaluate kernel for the current configuration (debug trace, profiler)
+void SDRAM::select_kernel()
+{
+    switch ((dbg_on ? 1 : 0) | ((fh_prof) || (heat_on) || (tmg_on) ? 2 : 0))
+    {
+        case 0  : eval_priv = pick_kernel<false, false>(); break;
+        case 1  : eval_priv = pick_kernel<true,  false>(); break;
+        case 2  : eval_priv = pick_kernel<false, true >(); break;
+        default : eval_priv = pick_kernel<true,  true >();
     }
+}
+
+// Cycle evaluate kernel specialized per data bus width, storage and banks layout
+template <bool DBG, bool PRF>
+SDRAM::eval_kernel_t SDRAM::pick_kernel()
+{
+    switch (bus_log2 | ((mem_flags & FLAG_WORD_STORAGE) ? 4 : 0) | ((mem_flags & FLAG_BANK_INTERLEAVING) ? 8 : 0))
+    {
+        // Byte lanes storage, contiguous banks
+        case 0x00 : return &SDRAM::eval_kernel<0, false, false, DBG, PRF>;
+        case 0x01 : return &SDRAM::eval_kernel<1, false, false, DBG, PRF>;
+        case 0x02 : return &SDRAM::eval_kernel<2, false, false, DBG, PRF>;
+        case 0x03 : return &SDRAM::eval_kernel<3, false, false, DBG, PRF>;
+        // Word-wide storage, contiguous banks
+        case 0x04 : return &SDRAM::eval_kernel<0, true,  false, DBG, PRF>;
+        case 0x05 : return &SDRAM::eval_kernel<1, true,  false, DBG, PRF>;
+        case 0x06 : return &SDRAM::eval_kernel<2, true,  false, DBG, PRF>;
+        case 0x07 : return &SDRAM::eval_kernel<3, true,  false, DBG, PRF>;
+        // Byte lanes storage, interleaved banks
+        case 0x08 : return &SDRAM::eval_kernel<0, false, true,  DBG, PRF>;
+        case 0x09 : return &SDRAM::eval_kernel<1, false, true,  DBG, PRF>;
+        case 0x0A : return &SDRAM::eval_kernel<2, false, true,  DBG, PRF>;
+        case 0x0B : return &SDRAM::eval_kernel<3, false, true,  DBG, PRF>;
+        // Word-wide storage, interleaved banks
+        case 0x0C : return &SDRAM::eval_kernel<0, true,  true,  DBG, PRF>;
+        case 0x0D : return &SDRAM::eval_kernel<1, true,  true,  DBG, PRF>;
+        case 0x0E : return &SDRAM::eval_kernel<2, true,  true,  DBG, PRF>;
+        default   : return &SDRAM::eval_kernel<3, true,  true,  DBG, PRF>;
+    }
+}
+
+// Destructor
+SDRAM::~SDRAM()
+{
+    // write the last records
+    if (fh_log)
+    {
+        trace_flush();
+        fclose(fh_log);
+    }
+    delete[] trc_buf;
     
-    if (flags & FLAG_RANDOM_FILLED)
+    // bandwidth profiler summary
+    if (fh_prof)
     {
-        // fill the arrays with random numbers
-        srand (time (NULL));
-        for (int i = 0; i < SDRAM_NUM_BANKS; i++)
+        prof_summary();
+        fclose(fh_prof);
+    }
+    
+    // access heatmap : cumulative map
+    if (heat_on)
+    {
+        heat_summary();
+        if (fh_heat) fclose(fh_heat);
+        delete[] heat_rd;
+        delete[] heat_wr;
+        delete[] heat_rd_tot;
+        delete[] heat_wr_tot;
+    }
+    
+    // timing checker : slack statistics
+    if (tmg_on) tmg_summary();
+    
+    // free the memory (anonymous or file mapping)
+    munmap((void *)mem_blk, mem_blk_size);
+}
+
+// Map a preloaded SDRAM image (copy-on-write)
+bool SDRAM::map_image(const char *name)
+{
+    int              fd;
+    struct stat      st;
+    sdram_image_hdr  hdr;
+    void            *ptr;
+    
+    fd = open(name, O_RDONLY);
+    if (fd < 0)
+    {
+        printf("SDRAM image \"%s\" not found\n", name);
+        return false;
+    }
+    
+    // check the image geometry
+    if ((read(fd, (void *)&hdr, sizeof(hdr)) != (ssize_t)sizeof(hdr)) ||
+        (memcmp(hdr.magic, SDRAM_IMAGE_MAGIC, 8)) ||
+        (hdr.bit_rows != (vluint32_t)bit_rows) ||
+        (hdr.bit_cols != (vluint32_t)bit_cols) ||
+        (hdr.flags != (vluint32_t)(mem_flags & SDRAM_IMAGE_FLAGS)) ||
+        (hdr.size != (vluint64_t)mem_blk_size))
+    {
+        close(fd);
+        printf("SDRAM image \"%s\" does not match the SDRAM geometry !!\n", name);
+        return false;
+    }
+    
+    // check the file size : a truncated image cannot be mapped
+    if ((fstat(fd, &st) < 0) ||
+        ((vluint64_t)st.st_size != (vluint64_t)SDRAM_IMAGE_HDR_SIZE + hdr.size))
+    {
+        close(fd);
+        printf("SDRAM image \"%s\" is truncated !!\n", name);
+        return false;
+    }
+    
+    // check the binary files it was built from (same sizes and dates)
+    if ((hdr.num_src == 0) || (hdr.num_src > IMAGE_MAX_SOURCES) ||
+        (read(fd, (void *)img_src, hdr.num_src * sizeof(sdram_image_src)) !=
+         (ssize_t)(hdr.num_src * sizeof(sdram_image_src))))
+    {
+        close(fd);
+        printf("SDRAM image \"%s\" has no valid binary files list !!\n", name);
+        return false;
+    }
+    for (int i = 0; i < (int)hdr.num_src; i++)
+    {
+        img_src[i].name[sizeof(img_src[i].name) - 1] = 0;
+        if ((stat(img_src[i].name, &st) < 0) ||
+            (img_src[i].size  != (vluint64_t)st.st_size) ||
+            (img_src[i].mtime != (vluint64_t)st.st_mtim.tv_sec * 1000000000 + (vluint64_t)st.st_mtim.tv_nsec))
         {
-            for (int j = 0; j < s; j++)
-            {
-                                      mem_array_0[i][j] = (vluint8_t)rand() & 0xFF;
-                if (flags & DATA_MSB) mem_array_1[i][j] = (vluint8_t)rand() & 0xFF;
-                if (flags & DATA_MSW) mem_array_2[i][j] = (vluint8_t)rand() & 0xFF;
-                if (flags & DATA_MSW) mem_array_3[i][j] = (vluint8_t)rand() & 0xFF;
-                if (flags & DATA_MSL) mem_array_4[i][j] = (vluint8_t)rand() & 0xFF;
-                if (flags & DATA_MSL) mem_array_5[i][j] = (vluint8_t)rand() & 0xFF;
-                if (flags & DATA_MSL) mem_array_6[i][j] = (vluint8_t)rand() & 0xFF;
-                if (flags & DATA_MSL) mem_array_7[i][j] = (vluint8_t)rand() & 0xFF;
-            }
+            close(fd);
+            printf("SDRAM image \"%s\" is older than binary file \"%s\"\n", name, img_src[i].name);
+            return false;
         }
     }
+    
+    ptr = mmap(NULL, mem_blk_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, SDRAM_IMAGE_HDR_SIZE);
+    close(fd);
+    if (ptr == MAP_FAILED)
+    {
+        printf("Cannot map SDRAM image \"%s\" !!\n", name);
+        return false;
+    }
+    
+    mem_blk     = (vluint8_t *)ptr;
+    img_src_cnt = (int)hdr.num_src;
+    printf("SDRAM image \"%s\" mapped\n", name);
+    
+    return true;
+}
+
+// Save the SDRAM content as an image that can be mapped later
+// (written into a temporary file, renamed once complete : other runs may have it mapped)
+bool SDRAM::save_image(const char *name)
+{
+    FILE            *fh;
+    sdram_image_hdr  hdr;
+    vluint8_t       *pad;
+    char             tmp_name[280];
+    bool             ok;
+    
+    // the image could not be checked against its binary files
+    if (img_src_cnt <= 0)
+    {
+        printf("SDRAM image \"%s\" not saved : binary files missing or too many of them !!\n", name);
+        return false;
+    }
+    
+    snprintf(tmp_name, sizeof(tmp_name), "%s.%d.tmp", name, (int)getpid());
+    fh = fopen(tmp_name, "wb");
+    if (!fh)
+    {
+        printf("Cannot save SDRAM image \"%s\" !!\n", name);
+        return false;
+    }
+    
+    // header and binary files list, padded to the data offset
+    memset((void *)&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, SDRAM_IMAGE_MAGIC, 8);
+    hdr.bit_rows = (vluint32_t)bit_rows;
+    hdr.bit_cols = (vluint32_t)bit_cols;
+    hdr.flags    = (vluint32_t)(mem_flags & SDRAM_IMAGE_FLAGS);
+    hdr.num_src  = (vluint32_t)img_src_cnt;
+    hdr.size     = (vluint64_t)mem_blk_size;
+    pad = new vluint8_t[SDRAM_IMAGE_HDR_SIZE];
+    memset((void *)pad, 0, SDRAM_IMAGE_HDR_SIZE);
+    memcpy((void *)pad, (void *)&hdr, sizeof(hdr));
+    memcpy((void *)(pad + sizeof(hdr)), (void *)img_src, img_src_cnt * sizeof(sdram_image_src));
+    
+    ok = (fwrite((void *)pad, SDRAM_IMAGE_HDR_SIZE, 1, fh) == 1) &&
+         (fwrite((void *)mem_blk, mem_blk_size, 1, fh) == 1);
+    ok = (fclose(fh) == 0) && (ok);
+    delete[] pad;
+    
+    // atomic replacement of the previous image
+    if ((ok) && (rename(tmp_name, name) == 0))
+    {
+        printf("SDRAM image \"%s\" saved\n", name);
+    }
     else
     {
-        // clear the arrays
+        unlink(tmp_name);
+        printf("Error while saving SDRAM image \"%s\" !!\n", name);
+        ok = false;
+    }
+    
+    return ok;
+}
+
+// True if the SDRAM content comes from a preloaded image
+bool SDRAM::image_mapped()
+{
+    return mem_mapped;
+}
+
+// Number of protocol errors detected so far
+int SDRAM::get_errors()
+{
+    return err_cnt;
+}
+
+// Bandwidth profiler : per bank accesses, binned per video line
+// (line_cycles clock cycles, line_slots accesses per bank at 100 % load)
+// and written per frame into a CSV file. The line bins start with the
+// first refresh of each line (sdram_ctrl.v refreshes once per line)
+void SDRAM::set_profile(const char *csv_file, int line_cycles, int line_slots)
+{
+    bool reopen = (fh_prof != NULL);
+    
+    if (fh_prof) fclose(fh_prof);
+    fh_prof = fopen(csv_file, "w");
+    if (!fh_prof)
+    {
+        printf("Cannot create SDRAM profile file \"%s\" !!\n", csv_file);
+        select_kernel();
+        return;
+    }
+    
+    fprintf(fh_prof, "frame,cycles,lines,idle,nop,ref");
+    for (int i = 0; i < SDRAM_NUM_BANKS; i++)
+    {
+        fprintf(fh_prof, ",act_%d,rd_%d,wr_%d,hit_%d,miss_%d,pre_%d,peak_%d,load_%d",
+                i, i, i, i, i, i, i, i);
+    }
+    fprintf(fh_prof, "\n");
+    
+    prf_line_cyc   = (line_cycles > 0) ? line_cycles : 1;
+    prf_line_slots = (line_slots > 0) ? line_slots : 1;
+    // Forked child (new file) : the current line goes on
+    if (!reopen)
+    {
+        prf_cyc_ctr = 0;
+        prf_ref_gap = prf_line_cyc;
         for (int i = 0; i < SDRAM_NUM_BANKS; i++)
         {
-            for (int j = 0; j < s; j++)
+            prf_line_acc[i] = 0;
+            prf_used[i]     = false;
+        }
+    }
+    memset((void *)&prf_frame, 0, sizeof(prf_frame));
+    memset((void *)&prf_total, 0, sizeof(prf_total));
+    memset((void *)prf_hist, 0, sizeof(prf_hist));
+    
+    printf("SDRAM profile file \"%s\" created (%d cycles, %d slots per line)\n",
+           csv_file, prf_line_cyc, prf_line_slots);
+    select_kernel();
+}
+
+// End of a video frame : one CSV line
+void SDRAM::prof_frame(int frame_nr)
+{
+    if (!fh_prof) return;
+    
+    fprintf(fh_prof, "%d,%llu,%llu,%llu,%llu,%llu", frame_nr,
+            (unsigned long long)prf_frame.cycles, (unsigned long long)prf_frame.lines,
+            (unsigned long long)prf_frame.idle,   (unsigned long long)prf_frame.nop,
+            (unsigned long long)prf_frame.ref);
+    for (int i = 0; i < SDRAM_NUM_BANKS; i++)
+    {
+        vluint64_t acc = prf_frame.hit[i] + prf_frame.miss[i];
+        
+        fprintf(fh_prof, ",%llu,%llu,%llu,%llu,%llu,%llu,%d,%.1f",
+                (unsigned long long)prf_frame.act[i], (unsigned long long)prf_frame.rd[i],
+                (unsigned long long)prf_frame.wr[i],  (unsigned long long)prf_frame.hit[i],
+                (unsigned long long)prf_frame.miss[i],(unsigned long long)prf_frame.pre[i],
+                prf_frame.peak[i],
+                (prf_frame.lines) ? 100.0 * (double)acc / (double)(prf_frame.lines * prf_line_slots) : 0.0);
+    }
+    fprintf(fh_prof, "\n");
+    
+    // Cumulated counters
+    prf_total.cycles += prf_frame.cycles;
+    prf_total.lines  += prf_frame.lines;
+    prf_total.idle   += prf_frame.idle;
+    prf_total.nop    += prf_frame.nop;
+    prf_total.ref    += prf_frame.ref;
+    for (int i = 0; i < SDRAM_NUM_BANKS; i++)
+    {
+        prf_total.act[i]  += prf_frame.act[i];
+        prf_total.rd[i]   += prf_frame.rd[i];
+        prf_total.wr[i]   += prf_frame.wr[i];
+        prf_total.hit[i]  += prf_frame.hit[i];
+        prf_total.miss[i] += prf_frame.miss[i];
+        prf_total.pre[i]  += prf_frame.pre[i];
+        if (prf_frame.peak[i] > prf_total.peak[i]) prf_total.peak[i] = prf_frame.peak[i];
+    }
+    memset((void *)&prf_frame, 0, sizeof(prf_frame));
+}
+
+// Bandwidth profiler : one command
+inline void SDRAM::prof_cmd(vluint8_t cmd, vluint8_t ba, vluint8_t a10)
+{
+    switch (cmd)
+    {
+        case CMD_REF:
+        {
+            prf_frame.ref++;
+            // First refresh of a line : the line bin restarts with it (the
+            // current one ends there, unless it has just been started)
+            if (prf_ref_gap > (prf_line_cyc >> 1))
             {
-                                      mem_array_0[i][j] = (vluint8_t)0;
-                if (flags & DATA_MSB) mem_array_1[i][j] = (vluint8_t)0;
-                if (flags & DATA_MSW) mem_array_2[i][j] = (vluint8_t)0;
-                if (flags & DATA_MSW) mem_array_3[i][j] = (vluint8_t)0;
-                if (flags & DATA_MSL) mem_array_4[i][j] = (vluint8_t)0;
-                if (flags & DATA_MSL) mem_array_5[i][j] = (vluint8_t)0;
-                if (flags & DATA_MSL) mem_array_6[i][j] = (vluint8_t)0;
-                if (flags & DATA_MSL) mem_array_7[i][j] = (vluint8_t)0;
+                if (prf_cyc_ctr > (prf_line_cyc >> 1)) prof_line();
+                prf_cyc_ctr = 0;
             }
+            prf_ref_gap = 0;
+            break;
+        }
+        case CMD_PRE:
+        {
+            for (int i = 0; i < SDRAM_NUM_BANKS; i++)
+            {
+                if ((row_act[i]) && ((a10) || (i == (int)ba))) prf_frame.pre[i]++;
+            }
+            break;
+        }
+        case CMD_ACT:
+        {
+            prf_frame.act[ba]++;
+            prf_used[ba] = false;
+            break;
         }
+        case CMD_WR:
+        case CMD_RD:
+        {
+            if (prf_used[ba])
+                prf_frame.hit[ba]++;
+            else
+                prf_frame.miss[ba]++;
+            prf_used[ba] = true;
+            prf_line_acc[ba]++;
+            // Auto-precharge
+            if (a10) prf_frame.pre[ba]++;
+            break;
+        }
+        default: ;
     }
 }
 
-// Destructor
-SDRAM::~SDRAM()
+// Bandwidth profiler : end of a clock cycle
+inline void SDRAM::prof_cycle(vluint64_t ts, vluint8_t cmd, int beats)
+{
+    // Refresh overdue : reported once, without waiting for the next refresh
+    if (++tmg_cyc > tmg_late) tmg_refi_late(ts);
+    tmg_ts = ts;
+    prf_frame.cycles++;
+    if (!beats) prf_frame.idle++;
+    if (cmd == CMD_NOP) prf_frame.nop++;
+    if (prf_ref_gap < prf_line_cyc) prf_ref_gap++;
+    
+    // End of a video line (no refresh : free running)
+    if (++prf_cyc_ctr == prf_line_cyc) prof_line();
+}
+
+// Bandwidth profiler : end of a video line, load histogram
+void SDRAM::prof_line()
 {
-    // free the memory
     for (int i = 0; i < SDRAM_NUM_BANKS; i++)
     {
-                                  delete[] mem_array_0[i];
-        if (mem_flags & DATA_MSB) delete[] mem_array_1[i];
-        if (mem_flags & DATA_MSW) delete[] mem_array_2[i];
-        if (mem_flags & DATA_MSW) delete[] mem_array_3[i];
-        if (mem_flags & DATA_MSL) delete[] mem_array_4[i];
-        if (mem_flags & DATA_MSL) delete[] mem_array_5[i];
-        if (mem_flags & DATA_MSL) delete[] mem_array_6[i];
-        if (mem_flags & DATA_MSL) delete[] mem_array_7[i];
+        int bin = (prf_line_acc[i] * 10) / prf_line_slots;
+        
+        prf_hist[i][(bin < PROF_HIST_SIZE) ? bin : PROF_HIST_SIZE - 1]++;
+        if (prf_line_acc[i] > prf_frame.peak[i]) prf_frame.peak[i] = prf_line_acc[i];
+        prf_line_acc[i] = 0;
     }
+    prf_frame.lines++;
+    prf_cyc_ctr = 0;
 }
 
-// Binary file loading
-void SDRAM::load(const char *name, vluint32_t size, vluint32_t addr)
+// Bandwidth profiler : summary and load histogram
+void SDRAM::prof_summary()
 {
-    FILE *fh;
+    // Last (partial) frame : numbered -1
+    if (prf_frame.cycles) prof_frame(-1);
     
-    fh = fopen(name, "rb");
-    if (fh)
+    printf("SDRAM profile : %llu lines, data bus busy %.1f %%, %llu refreshes\n",
+           (unsigned long long)prf_total.lines,
+           (prf_total.cycles) ? 100.0 * (double)(prf_total.cycles - prf_total.idle) / (double)prf_total.cycles : 0.0,
+           (unsigned long long)prf_total.ref);
+    if (!prf_total.lines) return;
+    
+    for (int i = 0; i < SDRAM_NUM_BANKS; i++)
     {
-        int        row_size; // Row size (num_cols * 1, 2 or 4)
-        vluint8_t *row_buf;  // Row buffer
-        int        row_pos;  // Row position (0 to num_rows - 1)
-        int        bank_nr;  // Bank number (0 to 3)
-        int        idx;      // Array index (0 to num_cols * num_rows - 1)
+        vluint64_t acc = prf_total.hit[i] + prf_total.miss[i];
         
-        // Row size computation based on data bus width
-        row_size = (int)1 << (bit_cols + bus_log2);
-        // Allocate one full row
-        row_buf = new vluint8_t[row_size];
-        
-        // Row position
-        row_pos = (int)addr >> (bit_cols + bus_log2);
-        // Banks layout
-        if (mem_flags & FLAG_BANK_INTERLEAVING)
+        printf(" Bank #%d : %6.1f accesses/line (%5.1f %% load), peak %d (%5.1f %%), row hits %5.1f %%, %.1f ACT/line\n",
+               i, (double)acc / (double)prf_total.lines,
+               100.0 * (double)acc / (double)(prf_total.lines * prf_line_slots),
+               prf_total.peak[i], 100.0 * (double)prf_total.peak[i] / (double)prf_line_slots,
+               (acc) ? 100.0 * (double)prf_total.hit[i] / (double)acc : 0.0,
+               (double)prf_total.act[i] / (double)prf_total.lines);
+    }
+    printf(" Lines per load :");
+    for (int k = 0; k < PROF_HIST_SIZE; k++)
+    {
+        if (k < PROF_HIST_SIZE - 1)
+            printf("   %3d %%", k * 10);
+        else
+            printf("  >=%3d %%", k * 10);
+    }
+    printf("\n");
+    for (int i = 0; i < SDRAM_NUM_BANKS; i++)
+    {
+        printf(" Bank #%d        :", i);
+        for (int k = 0; k < PROF_HIST_SIZE; k++)
         {
-            // Banks are interleaved
-            bank_nr = row_pos & (SDRAM_NUM_BANKS - 1);
-            row_pos = row_pos >> SDRAM_BIT_BANKS;
+            printf(" %7llu", (unsigned long long)prf_hist[i][k]);
         }
-        else
+        printf("\n");
+    }
+}
+
+// Access heatmap : named region (byte addresses), the pages outside of
+// the regions are counted as "other" (regions are declared before set_heatmap)
+void SDRAM::add_region(const char *name, vluint32_t addr, vluint32_t size)
+{
+    if (heat_on)
+    {
+        printf("SDRAM heatmap already started (%s ignored) !!\n", name);
+        return;
+    }
+    if (heat_reg_cnt >= HEAT_MAX_REGIONS)
+    {
+        printf("Too many SDRAM heatmap regions (%s ignored) !!\n", name);
+        return;
+    }
+    
+    snprintf(heat_reg_name[heat_reg_cnt], sizeof(heat_reg_name[0]), "%s", name);
+    heat_reg_addr[heat_reg_cnt] = addr;
+    heat_reg_size[heat_reg_cnt] = size;
+    heat_reg_cnt++;
+}
+
+// Access heatmap : reads and writes per page (2^page_log2 bytes), per-frame
+// map of the regions in "<prefix>_frames.csv", cumulative map of the pages
+// in "<prefix>_pages.csv" at the end
+void SDRAM::set_heatmap(const char *prefix, int page_log2)
+{
+    char name[256];
+    
+    if (fh_heat) fclose(fh_heat);
+    snprintf(name, sizeof(name), "%s_frames.csv", prefix);
+    fh_heat = fopen(name, "w");
+    if (!fh_heat)
+    {
+        printf("Cannot create SDRAM heatmap file \"%s\" !!\n", name);
+        return;
+    }
+    fprintf(fh_heat, "frame,region,reads,writes,pages,touched,new\n");
+    snprintf(heat_name, sizeof(heat_name), "%s_pages.csv", prefix);
+    strcpy(heat_reg_name[heat_reg_cnt], "other");
+    
+    // Page counters cleared
+    if (!heat_on)
+    {
+        heat_page_log2 = (page_log2 > bus_log2) ? page_log2 : bus_log2;
+        heat_pages     = (int)(mem_size >> heat_page_log2);
+        heat_rd        = new vluint32_t[heat_pages];
+        heat_wr        = new vluint32_t[heat_pages];
+        heat_rd_tot    = new vluint64_t[heat_pages];
+        heat_wr_tot    = new vluint64_t[heat_pages];
+    }
+    memset((void *)heat_rd,     0, sizeof(vluint32_t) * heat_pages);
+    memset((void *)heat_wr,     0, sizeof(vluint32_t) * heat_pages);
+    memset((void *)heat_rd_tot, 0, sizeof(vluint64_t) * heat_pages);
+    memset((void *)heat_wr_tot, 0, sizeof(vluint64_t) * heat_pages);
+    
+    printf("SDRAM heatmap file \"%s\" created (%d pages of %d bytes, %d regions)\n",
+           name, heat_pages, 1 << heat_page_log2, heat_reg_cnt);
+    heat_on = true;
+    select_kernel();
+}
+
+// Access heatmap : one CSV line per region at the end of a video frame
+void SDRAM::heat_frame(int frame_nr)
+{
+    vluint64_t reads[HEAT_MAX_REGIONS + 1];
+    vluint64_t writes[HEAT_MAX_REGIONS + 1];
+    int        pages[HEAT_MAX_REGIONS + 1];
+    int        touched[HEAT_MAX_REGIONS + 1];
+    int        fresh[HEAT_MAX_REGIONS + 1];
+    
+    if (!fh_heat) return;
+    
+    memset((void *)reads,   0, sizeof(reads));
+    memset((void *)writes,  0, sizeof(writes));
+    memset((void *)pages,   0, sizeof(pages));
+    memset((void *)touched, 0, sizeof(touched));
+    memset((void *)fresh,   0, sizeof(fresh));
+    for (int i = 0; i < heat_pages; i++)
+    {
+        int reg = heat_region(i);
+        
+        pages[reg]++;
+        if ((heat_rd[i]) || (heat_wr[i]))
         {
-            // Banks are contiguous
-            bank_nr = row_pos >> bit_rows;
-            row_pos = row_pos & (num_rows - 1);
+            // First access to this page
+            if ((!heat_rd_tot[i]) && (!heat_wr_tot[i])) fresh[reg]++;
+            touched[reg]++;
+            reads[reg]      += heat_rd[i];
+            writes[reg]     += heat_wr[i];
+            heat_rd_tot[i]  += heat_rd[i];
+            heat_wr_tot[i]  += heat_wr[i];
+            heat_rd[i] = heat_wr[i] = (vluint32_t)0;
         }
-        idx = row_pos << bit_cols;
+    }
+    
+    for (int k = 0; k <= heat_reg_cnt; k++)
+    {
+        fprintf(fh_heat, "%d,%s,%llu,%llu,%d,%d,%d\n", frame_nr, heat_reg_name[k],
+                (unsigned long long)reads[k], (unsigned long long)writes[k], pages[k], touched[k], fresh[k]);
+    }
+}
+
+// Access heatmap : cumulative map of the accessed pages and summary per region
+void SDRAM::heat_summary()
+{
+    vluint64_t reads[HEAT_MAX_REGIONS + 1];
+    vluint64_t writes[HEAT_MAX_REGIONS + 1];
+    int        pages[HEAT_MAX_REGIONS + 1];
+    int        touched[HEAT_MAX_REGIONS + 1];
+    FILE      *fh;
+    
+    // Last (partial) frame : numbered -1
+    heat_frame(-1);
+    
+    fh = fopen(heat_name, "w");
+    if (!fh)
+    {
+        printf("Cannot create SDRAM heatmap file \"%s\" !!\n", heat_name);
+        return;
+    }
+    fprintf(fh, "page,address,region,reads,writes\n");
+    
+    memset((void *)reads,   0, sizeof(reads));
+    memset((void *)writes,  0, sizeof(writes));
+    memset((void *)pages,   0, sizeof(pages));
+    memset((void *)touched, 0, sizeof(touched));
+    for (int i = 0; i < heat_pages; i++)
+    {
+        int reg = heat_region(i);
         
-        printf("Starting row : %d, starting bank : %d\n", row_pos, bank_nr);
-        printf("Loading 0x%08lX bytes @ 0x%08lX from binary file \"%s\"...", size, addr, name);
-        for (int i = 0; i < (int)size; i += row_size)
+        pages[reg]++;
+        if ((heat_rd_tot[i]) || (heat_wr_tot[i]))
+        {
+            fprintf(fh, "%d,0x%06X,%s,%llu,%llu\n", i, (unsigned)i << heat_page_log2, heat_reg_name[reg],
+                    (unsigned long long)heat_rd_tot[i], (unsigned long long)heat_wr_tot[i]);
+            touched[reg]++;
+            reads[reg]  += heat_rd_tot[i];
+            writes[reg] += heat_wr_tot[i];
+        }
+    }
+    fclose(fh);
+    
+    printf("SDRAM heatmap (pages of %d bytes) :\n", 1 << heat_page_log2);
+    for (int k = 0; k <= heat_reg_cnt; k++)
+    {
+        printf(" %-12s : %5d of %5d pages touched (%5.1f %%), %llu reads, %llu writes\n",
+               heat_reg_name[k], touched[k], pages[k], (pages[k]) ? 100.0 * (double)touched[k] / (double)pages[k] : 0.0,
+               (unsigned long long)reads[k], (unsigned long long)writes[k]);
+    }
+}
+
+// Access heatmap : region of a page (heat_reg_cnt : other)
+int SDRAM::heat_region(int page)
+{
+    vluint32_t addr = (vluint32_t)page << heat_page_log2;
+    
+    for (int k = 0; k < heat_reg_cnt; k++)
+    {
+        if ((addr >= heat_reg_addr[k]) && (addr - heat_reg_addr[k] < heat_reg_size[k])) return k;
+    }
+    
+    return heat_reg_cnt;
+}
+
+// Access heatmap : byte address of the current data beat
+template <bool ILV>
+inline vluint32_t SDRAM::heat_addr()
+{
+    if (ILV)
+        return (vluint32_t)((row_addr[bank] << SDRAM_BIT_BANKS) + (bank << bit_cols) + (row - row_addr[bank]) + col) << bus_log2;
+    else
+        return (vluint32_t)((bank << (bit_rows + bit_cols)) + row + col) << bus_log2;
+}
+
+// Timing checker : minimal delays between the commands (in clock cycles),
+// every violation is a protocol error
+void SDRAM::set_timing(const sdram_timing *tmg)
+{
+    tmg_min[TMG_RCD]  = tmg->rcd;
+    tmg_min[TMG_RP]   = tmg->rp;
+    tmg_min[TMG_RAS]  = tmg->ras;
+    tmg_min[TMG_RC]   = tmg->rc;
+    tmg_min[TMG_WR]   = tmg->wr;
+    tmg_min[TMG_RFC]  = tmg->rfc;
+    tmg_min[TMG_REFI] = tmg->refi;
+    
+    tmg_cyc = (vluint64_t)0;
+    for (int i = 0; i < SDRAM_NUM_BANKS; i++)
+    {
+        tmg_act[i] = TMG_NONE;
+        tmg_pre[i] = TMG_NONE;
+        tmg_wr[i]  = TMG_NONE;
+    }
+    tmg_ref  = TMG_NONE;
+    tmg_due  = TMG_NONE;
+    tmg_late = TMG_NONE;
+    for (int i = 0; i < TMG_NUM; i++)
+    {
+        tmg_checks[i]   = (vluint64_t)0;
+        tmg_viol[i]     = (vluint64_t)0;
+        tmg_slack_ts[i] = (vluint64_t)0;
+        tmg_slack[i]    = 0x7FFFFFFF;
+    }
+    
+    printf("SDRAM timing checker : tRCD=%d tRP=%d tRAS=%d tRC=%d tWR=%d tRFC=%d tREFI=%d cycles\n",
+           tmg->rcd, tmg->rp, tmg->ras, tmg->rc, tmg->wr, tmg->rfc, tmg->refi);
+    tmg_on = true;
+    select_kernel();
+}
+
+// Timing checker : one command
+void SDRAM::tmg_cmd(vluint64_t ts, vluint8_t cmd, vluint8_t ba, vluint8_t a10)
+{
+    switch (cmd)
+    {
+        case CMD_REF:
         {
-            // Read one full row from the binary file
-            fread((void *)row_buf, row_size, 1, fh);
+            vluint64_t last_pre = TMG_NONE;
             
-            // Here, we take care of the endianness
-            if (mem_flags & FLAG_BIG_ENDIAN)
-            {
-                // MSB first (motorola's way)
-                for (int j = 0; j < row_size; )
-                {
-                    // Write MSL (if present)
-                    if (mem_flags & DATA_MSL)
-                    {
-                        mem_array_7[bank_nr][idx] = row_buf[j++];
-                        mem_array_6[bank_nr][idx] = row_buf[j++];
-                        mem_array_5[bank_nr][idx] = row_buf[j++];
-                        mem_array_4[bank_nr][idx] = row_buf[j++];
-                    }
-                    // Write MSW (if present)
-                    if (mem_flags & DATA_MSW)
-                    {
-                        mem_array_3[bank_nr][idx] = row_buf[j++];
-                        mem_array_2[bank_nr][idx] = row_buf[j++];
-                    }
-                    // Write MSB (if present)
-                    if (mem_flags & DATA_MSB)
-                    {
-                        mem_array_1[bank_nr][idx] = row_buf[j++];
-                    }
-                    // Write LSB
-                    mem_array_0[bank_nr][idx] = row_buf[j++];
-                    // Next word
-                    idx++;
-                }
-            }
-            else
+            // All banks precharged, previous refresh done
+            for (int i = 0; i < SDRAM_NUM_BANKS; i++)
             {
-                // LSB first (intel's way)
-                for (int j = 0; j < row_size; )
-                {
-                    // Write LSB
-                    mem_array_0[bank_nr][idx] = row_buf[j++];
-                    // Write MSB (if present)
-                    if (mem_flags & DATA_MSB)
-                    {
-                        mem_array_1[bank_nr][idx] = row_buf[j++];
-                    }
-                    // Write MSW (if present)
-                    if (mem_flags & DATA_MSW)
-                    {
-                        mem_array_2[bank_nr][idx] = row_buf[j++];
-                        mem_array_3[bank_nr][idx] = row_buf[j++];
-                    }
-                    // Write MSL (if present)
-                    if (mem_flags & DATA_MSL)
-                    {
-                        mem_array_4[bank_nr][idx] = row_buf[j++];
-                        mem_array_5[bank_nr][idx] = row_buf[j++];
-                        mem_array_6[bank_nr][idx] = row_buf[j++];
-                        mem_array_7[bank_nr][idx] = row_buf[j++];
-                    }
-                    // Next word
-                    idx++;
-                }
+                if ((tmg_pre[i] != TMG_NONE) && ((last_pre == TMG_NONE) || (tmg_pre[i] > last_pre)))
+                    last_pre = tmg_pre[i];
             }
-            
-            // Compute next row's address
-            if (mem_flags & FLAG_BANK_INTERLEAVING)
+            tmg_check(ts, TMG_RP,  -1, last_pre, tmg_min[TMG_RP]);
+            tmg_check(ts, TMG_RFC, -1, tmg_ref,  tmg_min[TMG_RFC]);
+            // Refresh interval : up to 8 refreshes postponed, up to 8 pulled in
+            if (tmg_due != TMG_NONE)
             {
-                // Increment bank number
-                bank_nr = (bank_nr + 1) & (SDRAM_NUM_BANKS - 1);
+                int slack = (int)((vlsint64_t)(tmg_due + (vluint64_t)(8 * tmg_min[TMG_REFI])) - (vlsint64_t)tmg_cyc);
                 
-                // Bank #3 -> bank #0
-                if (!bank_nr)
+                if (slack < 0)
                 {
-                    row_pos ++;
-                    if ((row_pos == (int)num_rows) && ((i + row_size) < (int)size))
+                    // Late refresh, already reported by tmg_refi_late : the interval restarts
+                    if (slack < tmg_slack[TMG_REFI])
                     {
-                        printf("Memory overflow while loading !!\n");
-                        return;
+                        tmg_slack[TMG_REFI]    = slack;
+                        tmg_slack_ts[TMG_REFI] = ts;
                     }
+                    tmg_due = tmg_cyc + (vluint64_t)tmg_min[TMG_REFI];
                 }
                 else
                 {
-                    idx -= (int)num_cols;
+                    tmg_slack_upd(ts, TMG_REFI, -1, slack);
+                    tmg_due += (vluint64_t)tmg_min[TMG_REFI];
+                    if (tmg_due > tmg_cyc + (vluint64_t)(9 * tmg_min[TMG_REFI]))
+                        tmg_due = tmg_cyc + (vluint64_t)(9 * tmg_min[TMG_REFI]);
                 }
             }
             else
             {
-                // Increment row position
-                row_pos = (row_pos + 1) & ((int)num_rows - 1);
-                
-                // Last row in a bank
-                if (!row_pos)
+                tmg_due = tmg_cyc + (vluint64_t)tmg_min[TMG_REFI];
+            }
+            tmg_late = tmg_due + (vluint64_t)(8 * tmg_min[TMG_REFI]);
+            tmg_ref  = tmg_cyc;
+            break;
+        }
+        case CMD_PRE:
+        {
+            for (int i = 0; i < SDRAM_NUM_BANKS; i++)
+            {
+                // Only the active banks are precharged
+                if ((!a10) && (i != (int)ba)) continue;
+                if (!row_act[i]) continue;
+                tmg_check(ts, TMG_RAS, i, tmg_act[i], tmg_min[TMG_RAS]);
+                if ((tmg_wr[i] != TMG_NONE) && (tmg_wr[i] > tmg_act[i]))
+                    tmg_check(ts, TMG_WR, i, tmg_wr[i], tmg_min[TMG_WR]);
+                tmg_pre[i] = tmg_cyc;
+            }
+            break;
+        }
+        case CMD_ACT:
+        {
+            tmg_check(ts, TMG_RP,  ba, tmg_pre[ba], tmg_min[TMG_RP]);
+            tmg_check(ts, TMG_RC,  ba, tmg_act[ba], tmg_min[TMG_RC]);
+            tmg_check(ts, TMG_RFC, ba, tmg_ref,     tmg_min[TMG_RFC]);
+            tmg_act[ba] = tmg_cyc;
+            break;
+        }
+        case CMD_WR:
+        case CMD_RD:
+        {
+            tmg_check(ts, TMG_RCD, ba, tmg_act[ba], tmg_min[TMG_RCD]);
+            break;
+        }
+        default: ;
+    }
+}
+
+// Timing checker : delay since an event (TMG_NONE : no event yet)
+void SDRAM::tmg_check(vluint64_t ts, int param, int bank, vluint64_t since, int min_cyc)
+{
+    if (since == TMG_NONE) return;
+    
+    // The event can be in the future (auto-precharge)
+    tmg_slack_upd(ts, param, bank, (int)((vlsint64_t)tmg_cyc - (vlsint64_t)since) - min_cyc);
+}
+
+// Timing checker : refresh interval without waiting for the next refresh,
+// overdue after 8 postponed refreshes (the next refresh re-arms the check)
+void SDRAM::tmg_refi_late(vluint64_t ts)
+{
+    tmg_slack_upd(ts, TMG_REFI, -1, (int)((vlsint64_t)tmg_late - (vlsint64_t)tmg_cyc));
+    tmg_late = TMG_NONE;
+}
+
+// Timing checker : slack statistics, negative slack is a violation
+void SDRAM::tmg_slack_upd(vluint64_t ts, int param, int bank, int slack)
+{
+    tmg_checks[param]++;
+    if (slack < tmg_slack[param])
+    {
+        tmg_slack[param]    = slack;
+        tmg_slack_ts[param] = ts;
+    }
+    if (slack < 0)
+    {
+        if (tmg_viol[param] < TMG_MAX_PRINTS)
+        {
+            if (bank >= 0)
+                printf("ERROR @ %llu ps : %s violation on bank %d (%d cycle(s) short) !\n", ts, tmg_name[param], bank, -slack);
+            else
+                printf("ERROR @ %llu ps : %s violation (%d cycle(s) short) !\n", ts, tmg_name[param], -slack);
+        }
+        tmg_viol[param]++;
+        err_cnt++;
+    }
+}
+
+// Timing checker : minimal slack and violations per parameter
+void SDRAM::tmg_summary()
+{
+    // tREFI slack : before 8 postponed refreshes, the current interval included
+    if (tmg_late != TMG_NONE) tmg_refi_late(tmg_ts);
+    printf("SDRAM timings (%llu cycles) :\n", (unsigned long long)tmg_cyc);
+    for (int i = 0; i < TMG_NUM; i++)
+    {
+        if (!tmg_checks[i])
+        {
+            printf(" %-5s = %4d cycles : not checked\n", tmg_name[i], tmg_min[i]);
+            continue;
+        }
+        printf(" %-5s = %4d cycles : %10llu checks, min slack %6d cycle(s) @ %llu ps, %llu violation(s)\n",
+               tmg_name[i], tmg_min[i], (unsigned long long)tmg_checks[i],
+               tmg_slack[i], (unsigned long long)tmg_slack_ts[i], (unsigned long long)tmg_viol[i]);
+    }
+}
+
+// Binary file loading
+void SDRAM::load(const char *name, vluint32_t size, vluint32_t addr)
+{
+    int         fd;       // File descriptor
+    struct stat st;       // File status
+    vluint8_t  *file_buf; // File content (memory-mapped or read)
+    bool        mapped;   // File content is memory-mapped
+    int         len;      // Number of bytes to load
+    int         row_size; // Row size (num_cols * 1, 2 or 4)
+    int         row_pos;  // Row position (0 to num_rows - 1)
+    int         bank_nr;  // Bank number (0 to 3)
+    int         idx;      // Array index (0 to num_cols * num_rows - 1)
+    
+    fd = open(name, O_RDONLY);
+    if ((fd < 0) || (fstat(fd, &st) < 0))
+    {
+        if (fd >= 0) close(fd);
+        img_src_cnt = -1;
+        printf("Cannot load binary file \"%s\" !!\n", name);
+        return;
+    }
+    
+    // Only load what is available in the file
+    len = ((vluint64_t)st.st_size < (vluint64_t)size) ? (int)st.st_size : (int)size;
+    if (len <= 0)
+    {
+        close(fd);
+        img_src_cnt = -1;
+        printf("Binary file \"%s\" is empty !!\n", name);
+        return;
+    }
+    
+    // Binary files list of the SDRAM image
+    if ((img_src_cnt >= 0) && (img_src_cnt < IMAGE_MAX_SOURCES) && (strlen(name) < sizeof(img_src[0].name)))
+    {
+        memset((void *)&img_src[img_src_cnt], 0, sizeof(sdram_image_src));
+        strcpy(img_src[img_src_cnt].name, name);
+        img_src[img_src_cnt].size  = (vluint64_t)st.st_size;
+        img_src[img_src_cnt].mtime = (vluint64_t)st.st_mtim.tv_sec * 1000000000 + (vluint64_t)st.st_mtim.tv_nsec;
+        img_src_cnt++;
+    }
+    else
+    {
+        img_src_cnt = -1;
+    }
+    
+    // Map the whole file, read it if it cannot be mapped
+    file_buf = (vluint8_t *)mmap(NULL, (size_t)len, PROT_READ, MAP_PRIVATE, fd, 0);
+    mapped   = (file_buf != (vluint8_t *)MAP_FAILED);
+    if (mapped)
+    {
+        madvise((void *)file_buf, (size_t)len, MADV_SEQUENTIAL);
+    }
+    else
+    {
+        file_buf = new vluint8_t[len];
+        for (int i = 0; i < len; )
+        {
+            ssize_t n = read(fd, (void *)(file_buf + i), (size_t)(len - i));
+            if (n <= 0)
+            {
+                // Should not happen : clear the missing part
+                memset((void *)(file_buf + i), 0, (size_t)(len - i));
+                break;
+            }
+            i += (int)n;
+        }
+    }
+    close(fd);
+    
+    // Row size computation based on data bus width
+    row_size = (int)1 << (bit_cols + bus_log2);
+    
+    // Row position
+    row_pos = (int)addr >> (bit_cols + bus_log2);
+    // Banks layout
+    if (mem_flags & FLAG_BANK_INTERLEAVING)
+    {
+        // Banks are interleaved
+        bank_nr = row_pos & (SDRAM_NUM_BANKS - 1);
+        row_pos = row_pos >> SDRAM_BIT_BANKS;
+    }
+    else
+    {
+        // Banks are contiguous
+        bank_nr = row_pos >> bit_rows;
+        row_pos = row_pos & (num_rows - 1);
+    }
+    idx = row_pos << bit_cols;
+    
+    printf("Starting row : %d, starting bank : %d\n", row_pos, bank_nr);
+    printf("Loading 0x%08lX bytes @ 0x%08lX from binary file \"%s\"...", size, addr, name);
+    for (int i = 0; i < len; )
+    {
+        int        rows;  // Number of rows loaded at once
+        int        bytes; // Number of bytes loaded at once
+        
+        // Banks are contiguous : all the rows up to the end of the bank at once
+        rows  = (mem_flags & FLAG_BANK_INTERLEAVING) ? 1 : (int)num_rows - row_pos;
+        bytes = ((len - i) < rows * row_size) ? (len - i) : rows * row_size;
+        
+        if (bytes & bus_mask)
+        {
+            // Incomplete last word : zero padded
+            int        words = (bytes >> bus_log2) + 1;
+            vluint8_t *tmp   = new vluint8_t[words << bus_log2];
+            
+            memset((void *)tmp, 0, words << bus_log2);
+            memcpy((void *)tmp, (void *)(file_buf + i), bytes);
+            load_words(tmp, bank_nr, idx, words);
+            delete[] tmp;
+        }
+        else
+        {
+            load_words(file_buf + i, bank_nr, idx, bytes >> bus_log2);
+        }
+        i += rows * row_size;
+        
+        // Compute next row's address
+        if (mem_flags & FLAG_BANK_INTERLEAVING)
+        {
+            // Increment bank number
+            bank_nr = (bank_nr + 1) & (SDRAM_NUM_BANKS - 1);
+            
+            // Bank #3 -> bank #0
+            if (!bank_nr)
+            {
+                row_pos ++;
+                idx += (int)num_cols;
+                if ((row_pos == (int)num_rows) && (i < len))
                 {
-                    idx = 0;
-                    bank_nr++;
-                    if ((bank_nr == SDRAM_NUM_BANKS) && ((i + row_size) < (int)size))
-                    {
-                        printf("Memory overflow while loading !!\n");
-                        return;
-                    }
+                    printf("Memory overflow while loading !!\n");
+                    break;
                 }
             }
         }
+        else
+        {
+            // Next bank
+            idx     = 0;
+            row_pos = 0;
+            bank_nr++;
+            if ((bank_nr == SDRAM_NUM_BANKS) && (i < len))
+            {
+                printf("Memory overflow while loading !!\n");
+                break;
+            }
+        }
+    }
+    if (len < (int)size)
+        printf("OK (0x%08X bytes only)\n", len);
+    else
         printf("OK\n");
+    
+    if (mapped)
+        munmap((void *)file_buf, (size_t)len);
+    else
+        delete[] file_buf;
+}
+
+// Scatter whole words from a binary image into the byte lanes arrays
+void SDRAM::load_words(const vluint8_t *src, int bank_nr, int idx, int words)
+{
+    if (mem_flags & FLAG_WORD_STORAGE)
+    {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        if (!lane_swap)
+        {
+            // Same byte order : straight copy
+            memcpy((void *)(mem_bank[bank_nr] + (idx << bus_log2)), (void *)src, words << bus_log2);
+            return;
+        }
+#endif
+        int        bytes = bus_mask + 1;
         
-        delete[] row_buf;
+        for (int j = 0; j < words; j++)
+        {
+            vluint64_t data = (vluint64_t)0;
+            
+            // Here, we take care of the endianness
+            for (int k = 0; k < bytes; k++)
+            {
+                data |= (vluint64_t)src[j * bytes + k] << ((k ^ lane_swap) << 3);
+            }
+            set_word(bank_nr, idx + j, data);
+        }
+    }
+    else if ((bus_log2 == 1) && !(mem_flags & FLAG_BIG_ENDIAN))
+    {
+        // 16-bit, LSB first : fast path (vectorized by the compiler)
+        vluint8_t * __restrict__ dst0 = mem_array_0[bank_nr] + idx;
+        vluint8_t * __restrict__ dst1 = mem_array_1[bank_nr] + idx;
+        
+        for (int j = 0; j < words; j++)
+        {
+            dst0[j] = src[j * 2    ];
+            dst1[j] = src[j * 2 + 1];
+        }
     }
     else
     {
-        printf("Cannot load binary file \"%s\" !!\n", name);
+        vluint8_t *lanes[8] = { mem_array_0[bank_nr], mem_array_1[bank_nr],
+                                mem_array_2[bank_nr], mem_array_3[bank_nr],
+                                mem_array_4[bank_nr], mem_array_5[bank_nr],
+                                mem_array_6[bank_nr], mem_array_7[bank_nr] };
+        int        bytes = bus_mask + 1;
+        
+        // One pass per byte lane, no per-byte branching
+        for (int k = 0; k < bytes; k++)
+        {
+            // Here, we take care of the endianness
+            vluint8_t * __restrict__ dst = lanes[(mem_flags & FLAG_BIG_ENDIAN) ? bus_mask - k : k] + idx;
+            const vluint8_t         *ptr = src + k;
+            
+            for (int j = 0; j < words; j++)
+            {
+                dst[j] = ptr[j * bytes];
+            }
+        }
     }
 }
 
@@ -444,7 +1338,22 @@ void SDRAM::save(const char *name, vluint32_t size, vluint32_t addr)
         for (int i = 0; i < (int)size; i += row_size)
         {
             // Here, we take care of the endianness
-            if (mem_flags & FLAG_BIG_ENDIAN)
+            if (mem_flags & FLAG_WORD_STORAGE)
+            {
+                // Byte order given by the lane swap
+                for (int j = 0; j < row_size; )
+                {
+                    vluint64_t data = get_word(bank_nr, idx);
+                    
+                    for (int k = 0; k <= bus_mask; k++)
+                    {
+                        row_buf[j++] = (vluint8_t)(data >> ((k ^ lane_swap) << 3));
+                    }
+                    // Next word
+                    idx++;
+                }
+            }
+            else if (mem_flags & FLAG_BIG_ENDIAN)
             {
                 // MSB first (motorola's way)
                 for (int j = 0; j < row_size; )
@@ -557,6 +1466,188 @@ void SDRAM::save(const char *name, vluint32_t size, vluint32_t addr)
     }
 }
 
+#if VM_SAVABLE
+// Save the SDRAM content and state (checkpoint)
+void SDRAM::save_state(VerilatedSerialize &os)
+{
+    sdram_image_hdr hdr;
+    
+    // same header as the SDRAM image
+    memset((void *)&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, SDRAM_IMAGE_MAGIC, 8);
+    hdr.bit_rows = (vluint32_t)bit_rows;
+    hdr.bit_cols = (vluint32_t)bit_cols;
+    hdr.flags    = (vluint32_t)(mem_flags & SDRAM_IMAGE_FLAGS);
+    hdr.size     = (vluint64_t)mem_blk_size;
+    os.write((void *)&hdr, sizeof(hdr));
+    
+    // memory arrays
+    os.write((void *)mem_blk, mem_blk_size);
+    
+    // mode register
+    os.write((void *)&cas_lat,    sizeof(cas_lat));
+    os.write((void *)&bst_len_rd, sizeof(bst_len_rd));
+    os.write((void *)&bst_len_wr, sizeof(bst_len_wr));
+    os.write((void *)&bst_type,   sizeof(bst_type));
+    
+    // internal variables
+    os.write((void *)&prev_clk,   sizeof(prev_clk));
+    os.write((void *)cmd_pipe,    sizeof(cmd_pipe));
+    os.write((void *)col_pipe,    sizeof(col_pipe));
+    os.write((void *)ba_pipe,     sizeof(ba_pipe));
+    os.write((void *)bap_pipe,    sizeof(bap_pipe));
+    os.write((void *)a10_pipe,    sizeof(a10_pipe));
+    os.write((void *)dqm_pipe,    sizeof(dqm_pipe));
+    os.write((void *)row_act,     sizeof(row_act));
+    os.write((void *)row_pre,     sizeof(row_pre));
+    os.write((void *)row_addr,    sizeof(row_addr));
+    os.write((void *)ap_bank,     sizeof(ap_bank));
+    os.write((void *)&bank,       sizeof(bank));
+    os.write((void *)&row,        sizeof(row));
+    os.write((void *)&col,        sizeof(col));
+    os.write((void *)&bst_ctr_rd, sizeof(bst_ctr_rd));
+    os.write((void *)&bst_ctr_wr, sizeof(bst_ctr_wr));
+}
+
+// Restore the SDRAM content and state (checkpoint)
+bool SDRAM::restore_state(VerilatedDeserialize &is)
+{
+    sdram_image_hdr hdr;
+    
+    is.read((void *)&hdr, sizeof(hdr));
+    if ((memcmp(hdr.magic, SDRAM_IMAGE_MAGIC, 8)) ||
+        (hdr.bit_rows != (vluint32_t)bit_rows) ||
+        (hdr.bit_cols != (vluint32_t)bit_cols) ||
+        (hdr.flags != (vluint32_t)(mem_flags & SDRAM_IMAGE_FLAGS)) ||
+        (hdr.size != (vluint64_t)mem_blk_size))
+    {
+        printf("Checkpoint does not match the SDRAM geometry !!\n");
+        return false;
+    }
+    
+    // memory arrays
+    is.read((void *)mem_blk, mem_blk_size);
+    
+    // mode register
+    is.read((void *)&cas_lat,    sizeof(cas_lat));
+    is.read((void *)&bst_len_rd, sizeof(bst_len_rd));
+    is.read((void *)&bst_len_wr, sizeof(bst_len_wr));
+    is.read((void *)&bst_type,   sizeof(bst_type));
+    
+    // internal variables
+    is.read((void *)&prev_clk,   sizeof(prev_clk));
+    is.read((void *)cmd_pipe,    sizeof(cmd_pipe));
+    is.read((void *)col_pipe,    sizeof(col_pipe));
+    is.read((void *)ba_pipe,     sizeof(ba_pipe));
+    is.read((void *)bap_pipe,    sizeof(bap_pipe));
+    is.read((void *)a10_pipe,    sizeof(a10_pipe));
+    is.read((void *)dqm_pipe,    sizeof(dqm_pipe));
+    is.read((void *)row_act,     sizeof(row_act));
+    is.read((void *)row_pre,     sizeof(row_pre));
+    is.read((void *)row_addr,    sizeof(row_addr));
+    is.read((void *)ap_bank,     sizeof(ap_bank));
+    is.read((void *)&bank,       sizeof(bank));
+    is.read((void *)&row,        sizeof(row));
+    is.read((void *)&col,        sizeof(col));
+    is.read((void *)&bst_ctr_rd, sizeof(bst_ctr_rd));
+    is.read((void *)&bst_ctr_wr, sizeof(bst_ctr_wr));
+    
+    return true;
+}
+#endif /* VM_SAVABLE */
+
+// Read a word from the word-wide storage
+inline vluint64_t SDRAM::get_word(int bank_nr, int idx)
+{
+    switch (bus_log2)
+    {
+        case 0  : return (vluint64_t)(            mem_bank[bank_nr])[idx];
+        case 1  : return (vluint64_t)((vluint16_t *)mem_bank[bank_nr])[idx];
+        case 2  : return (vluint64_t)((vluint32_t *)mem_bank[bank_nr])[idx];
+        default : return             ((vluint64_t *)mem_bank[bank_nr])[idx];
+    }
+}
+
+// Write a word to the word-wide storage
+inline void SDRAM::set_word(int bank_nr, int idx, vluint64_t data)
+{
+    switch (bus_log2)
+    {
+        case 0  :                mem_bank[bank_nr] [idx] = (vluint8_t)data;  break;
+        case 1  : ((vluint16_t *)mem_bank[bank_nr])[idx] = (vluint16_t)data; break;
+        case 2  : ((vluint32_t *)mem_bank[bank_nr])[idx] = (vluint32_t)data; break;
+        default : ((vluint64_t *)mem_bank[bank_nr])[idx] = data;             break;
+    }
+}
+
+// Append one record to the binary trace
+inline void SDRAM::trace(vluint64_t ts, vluint8_t type, vluint8_t ba, vluint16_t addr, vluint8_t dqm, vluint64_t data)
+{
+    sdram_trace_rec *rec = trc_buf + trc_cnt;
+    
+    rec->ts     = ts;
+    rec->data   = data;
+    rec->addr   = addr;
+    rec->type   = type;
+    rec->ba     = ba;
+    rec->dqm    = dqm;
+    rec->pad[0] = (vluint8_t)0;
+    rec->pad[1] = (vluint8_t)0;
+    rec->pad[2] = (vluint8_t)0;
+    
+    // Buffer full : write it
+    if (++trc_cnt == TRACE_BUF_SIZE) trace_flush();
+}
+
+// Create the binary trace file (header only)
+bool SDRAM::trace_open(const char *name)
+{
+    sdram_trace_hdr hdr;
+    
+    fh_log = fopen(name, "wb");
+    if (!fh_log)
+    {
+        printf("Cannot create SDRAM trace file \"%s\" !!\n", name);
+        return false;
+    }
+    
+    memset((void *)&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, TRC_MAGIC, 8);
+    hdr.bus_log2 = (uint32_t)bus_log2;
+    hdr.bit_rows = (uint32_t)bit_rows;
+    hdr.bit_cols = (uint32_t)bit_cols;
+    hdr.flags    = (uint32_t)mem_flags;
+    fwrite((void *)&hdr, sizeof(hdr), 1, fh_log);
+    printf("SDRAM trace file \"%s\" created\n", name);
+    
+    return true;
+}
+
+// Forked child process : the binary trace goes on in "<trace file>_<nn>",
+// the records not written yet belong to the parent trace file (the records
+// are dropped if the file cannot be created)
+void SDRAM::fork_trace(int child_nr)
+{
+    char name[280];
+    
+    if (!fh_log) return;
+    
+    trc_cnt = 0;
+    fclose(fh_log);
+    snprintf(name, sizeof(name), "%s_%02d", trc_name, child_nr);
+    trace_open(name);
+}
+
+// Write the buffered records to the trace file
+void SDRAM::trace_flush()
+{
+    if (trc_cnt)
+    {
+        if (fh_log) fwrite((void *)trc_buf, sizeof(sdram_trace_rec), trc_cnt, fh_log);
+        trc_cnt = 0;
+    }
+}
+
 // Read a byte
 vluint8_t SDRAM::read_byte(vluint32_t addr)
 {
@@ -651,717 +1742,629 @@ void SDRAM::eval
         // Rising edge on clock
         if (clk && !(prev_clk))
         {
-            vluint8_t  cmd;
-            vluint8_t  a10;
+            eval_posedge(ts, cs_n, ras_n, cas_n, we_n, ba, addr, dqm, dq_in, dq_out);
+        }
+        
+        // For edge detection
+        prev_clk = clk;
+    }
+    // Clock disabled
+    else
+    {
+        prev_clk = (vluint8_t)0;
+    }
+}
 
-            // Decode SDRAM command            
-            if (!cs_n)
-                cmd = (ras_n << 2) | (cas_n << 1) | we_n;
-            else
-                cmd = CMD_NOP;
-                
-            // A[10] wire
-            a10 = (vluint8_t)((addr >> 10) & 1);
-            // Mask out extra bits
-            ba &= (SDRAM_NUM_BANKS - 1);
+// Cycle evaluate on a clock rising edge (clock enabled, edge detected by the caller)
+void SDRAM::eval_posedge
+(
+    vluint64_t ts,
+    // Commands
+    vluint8_t cs_n,
+    vluint8_t ras_n,
+    vluint8_t cas_n,
+    vluint8_t we_n,
+    // Address
+    vluint8_t ba,
+    vluint16_t addr,
+    // Data
+    vluint8_t dqm,
+    vluint64_t dq_in,
+    vluint64_t &dq_out
+)
+{
+    (this->*eval_priv)(ts, cs_n, ras_n, cas_n, we_n, ba, addr, dqm, dq_in, dq_out);
+}
 
-            // Command pipeline
-            for (int i = 0; i < CMD_PIPE_DEPTH; i++)
-            {
-                if (i == (CMD_PIPE_DEPTH - 1))
-                {
-                    cmd_pipe[i] = CMD_NOP;
-                    col_pipe[i] = (int)0;
-                    ba_pipe[i]  = (vluint8_t)0;
-                    bap_pipe[i] = (vluint8_t)0;
-                    a10_pipe[i] = (vluint16_t)0;
-                }
-                else
-                {
-                    cmd_pipe[i] = cmd_pipe[i+1];
-                    col_pipe[i] = col_pipe[i+1];
-                    ba_pipe[i]  = ba_pipe[i+1];
-                    bap_pipe[i] = bap_pipe[i+1];
-                    a10_pipe[i] = a10_pipe[i+1];
-                }
-            }
+// Cycle evaluate kernel, specialized per data bus width, storage, banks layout, debug mode and profiler
+template <int BUS_LOG2, bool WORD, bool ILV, bool DBG, bool PRF>
+void SDRAM::eval_kernel
+(
+    vluint64_t ts,
+    // Commands
+    vluint8_t cs_n,
+    vluint8_t ras_n,
+    vluint8_t cas_n,
+    vluint8_t we_n,
+    // Address
+    vluint8_t ba,
+    vluint16_t addr,
+    // Data
+    vluint8_t dqm,
+    vluint64_t dq_in,
+    vluint64_t &dq_out
+)
+{
+    typedef typename sdram_word<BUS_LOG2>::type word_t;
+    vluint8_t  cmd;
+    vluint8_t  a10;
+    int        beats = 0;
 
-            // DQM pipeline
-            dqm_pipe[0] = dqm_pipe[1];
-            dqm_pipe[1] = dqm;
-            
-            // Process SDRAM command (immediate)
-            switch (cmd)
+    // Decode SDRAM command            
+    if (!cs_n)
+        cmd = (ras_n << 2) | (cas_n << 1) | we_n;
+    else
+        cmd = CMD_NOP;
+        
+    // A[10] wire
+    a10 = (vluint8_t)((addr >> 10) & 1);
+    // Mask out extra bits
+    ba &= (SDRAM_NUM_BANKS - 1);
+
+    // Command pipeline
+    for (int i = 0; i < CMD_PIPE_DEPTH; i++)
+    {
+        if (i == (CMD_PIPE_DEPTH - 1))
+        {
+            cmd_pipe[i] = CMD_NOP;
+            col_pipe[i] = (int)0;
+            ba_pipe[i]  = (vluint8_t)0;
+            bap_pipe[i] = (vluint8_t)0;
+            a10_pipe[i] = (vluint16_t)0;
+        }
+        else
+        {
+            cmd_pipe[i] = cmd_pipe[i+1];
+            col_pipe[i] = col_pipe[i+1];
+            ba_pipe[i]  = ba_pipe[i+1];
+            bap_pipe[i] = bap_pipe[i+1];
+            a10_pipe[i] = a10_pipe[i+1];
+        }
+    }
+
+    // DQM pipeline
+    dqm_pipe[0] = dqm_pipe[1];
+    dqm_pipe[1] = dqm;
+    
+    // Bandwidth profiler (commands), timing checker
+    if (PRF)
+    {
+        prof_cmd(cmd, ba, a10);
+        if ((tmg_on) && (cmd != CMD_NOP)) tmg_cmd(ts, cmd, ba, a10);
+    }
+    
+    // Process SDRAM command (immediate)
+    switch (cmd)
+    {
+        // 000 : Load mode register
+        case CMD_LMR:
+        {
+            if (DBG)
             {
-                // 000 : Load mode register
-                case CMD_LMR:
-                {
-                    if (dbg_on)
-                    {
-                        printf("Load Std Mode Register @ %llu ps\n", ts);
-                        log_size += sprintf(log_buf + log_size, "Load Std Mode Register @ %llu ps\n", ts);
-                    }
-                        
-                    // CAS latency
-                    switch((addr >> 4) & 7)
-                    {
-                        case 2:
-                        {
-                            if (dbg_on)
-                            {
-                                printf("CAS latency        = 2 cycles\n");
-                                log_size += sprintf(log_buf + log_size, "CAS latency        = 2 cycles\n");
-                            }
-                            cas_lat = (int)2;
-                            break;
-                        }
-                        case 3:
-                        {
-                            if (dbg_on)
-                            {
-                                printf("CAS latency        = 3 cycles\n");
-                                log_size += sprintf(log_buf + log_size, "CAS latency        = 3 cycles\n");
-                            }
-                            cas_lat = (int)3;
-                            break;
-                        }
-                        default:
-                        {
-                            if (dbg_on)
-                            {
-                                printf("CAS latency        = ???\n");
-                                log_size += sprintf(log_buf + log_size, "CAS latency        = ???\n");
-                            }
-                            cas_lat = (int)0; // This disables pipelined commands
-                        }
-                    }
-                    
-                    // Burst length
-                    switch (addr & 7)
-                    {
-                        case 0:
-                        {
-                            if (dbg_on)
-                            {
-                                printf("Read burst length  = 1 word\n");
-                                log_size += sprintf(log_buf + log_size, "Read burst length  = 1 word\n");
-                            }
-                            bst_len_rd = (int)1;
-                            break;
-                        }
-                        case 1:
-                        {
-                            if (dbg_on)
-                            {
-                                printf("Read burst length  = 2 words\n");
-                                log_size += sprintf(log_buf + log_size, "Read burst length  = 2 words\n");
-                            }
-                            bst_len_rd = (int)2;
-                            break;
-                        }
-                        case 2:
-                        {
-                            if (dbg_on)
-                            {
-                                printf("Read burst length  = 4 words\n");
-                                log_size += sprintf(log_buf + log_size, "Read burst length  = 4 words\n");
-                            }
-                            bst_len_rd = (int)4;
-                            break;
-                        }
-                        case 3:
-                        {
-                            if (dbg_on)
-                            {
-                                printf("Read burst length  = 8 words\n");
-                                log_size += sprintf(log_buf + log_size, "Read burst length  = 8 words\n");
-                            }
-                            bst_len_rd = (int)8;
-                            break;
-                        }
-                        case 7:
-                        {
-                            if (dbg_on)
-                            {
-                                printf("Read burst length  = continuous\n");
-                                log_size += sprintf(log_buf + log_size, "Read burst length  = continuous\n");
-                            }
-                            bst_len_rd = (int)num_cols;
-                            break;
-                        }
-                        default:
-                        {
-                            if (dbg_on)
-                            {
-                                printf("Read burst length  = ???\n");
-                                log_size += sprintf(log_buf + log_size, "Read burst length  = ???\n");
-                            }
-                            bst_len_rd = (int)0; // This will disable burst read
-                        }
-                    }
-                    
-                    // Burst type
-                    if (addr & 8)
-                    {
-                        if (dbg_on)
-                        {
-                            printf("Burst type         = interleaved (NOT SUPPORTED !)\n");
-                            log_size += sprintf(log_buf + log_size, "Burst type         = interleaved (NOT SUPPORTED !)\n");
-                        }
-                        bst_type = (vluint8_t)1;
-                    }
-                    else
-                    {
-                        if (dbg_on)
-                        {
-                            printf("Burst type         = sequential\n");
-                            log_size += sprintf(log_buf + log_size, "Burst type         = sequential\n");
-                        }
-                        bst_type = (vluint8_t)0;
-                    }
-                    
-                    // Write burst
-                    if (addr & 0x200)
-                    {
-                        if (dbg_on)
-                        {
-                            printf("Write burst length = 1\n");
-                            log_size += sprintf(log_buf + log_size, "Write burst length = 1\n");
-                        }
-                        bst_len_wr = (int)1;
-                    }
-                    else
-                    {
-                        if (dbg_on)
-                        {
-                            if (bst_len_rd)
-                            {
-                                if (bst_len_rd <= (int)8)
-                                {
-                                    printf("Write burst length = %d word(s)\n", bst_len_rd);
-                                    log_size += sprintf(log_buf + log_size, "Write burst length = %d word(s)\n", bst_len_rd);
-                                }
-                                else
-                                {
-                                    printf("Write burst length = continuous\n");
-                                    log_size += sprintf(log_buf + log_size, "Write burst length = continuous\n");
-                                }
-                            }
-                            else
-                            {
-                                // This disables burst write
-                                printf("Write burst length = ???\n");
-                                log_size += sprintf(log_buf + log_size, "Write burst length = ???\n");
-                            }
-                        }
-                        bst_len_wr = bst_len_rd;
-                    }
-                    break;
-                }
-                // 001 : Auto refresh
-                case CMD_REF:
-                {
-                    if (dbg_on)
-                        log_size += sprintf(log_buf + log_size, "Auto Refresh @ %llu ps\n", ts);
-                    
-                    for (int i = 0; i < SDRAM_NUM_BANKS; i++)
-                    {
-                        if (!row_pre[i])
-                        {
-                            printf("ERROR @ %llu ps : All banks must be Precharge before Auto Refresh\n", ts);
-                            break;
-                        }
-                    }
-                    break;
-                }
-                // 010 : Precharge
-                case CMD_PRE:
-                {
-                    if (a10)
-                    {
-                        if (dbg_on)
-                            log_size += sprintf(log_buf + log_size, "Precharge all banks @ %llu ps\n", ts);
-                        
-                        if (ap_bank[0] || ap_bank[1] || ap_bank[2] || ap_bank[3])
-                        {
-                            printf("ERROR @ %llu ps : at least one bank is auto-precharged !\n", ts);
-                            break;
-                        }
-                        
-                        // Precharge all banks
-                        for (int i = 0; i < SDRAM_NUM_BANKS; i++)
-                        {
-                            row_act[i] = 0;
-                            row_pre[i] = 1;
-                        }
-                    }
-                    else
-                    {
-                        if (dbg_on)
-                            log_size += sprintf(log_buf + log_size, "Precharge bank #%d @ %llu ps\n", ba, ts);
-                            
-                        if (ap_bank[ba])
-                        {
-                            printf("ERROR @ %llu ps : cannot apply a precharge to auto-precharged bank %d !\n", ts, ba);
-                            break;
-                        }
-                        
-                        // Precharge one bank
-                        row_act[ba] = 0;
-                        row_pre[ba] = 1;
-                    }
-                    
-                    // Terminate a WRITE immediately
-                    if ((a10) || (bank == (int)ba))
-                        bst_ctr_wr = 0;
-                    
-                    // CAS latency pipeline for READ
-                    if (cas_lat)
-                    {
-                        cmd_pipe[cas_lat] = CMD_PRE;
-                        bap_pipe[cas_lat] = ba;
-                        a10_pipe[cas_lat] = a10;
-                    }
-                    
-                    break;
-                }
-                // 011 : Activate
-                case CMD_ACT:
-                {
-                    // Mask out extra bits
-                    addr &= (num_rows - 1);
-                    
-                    if (dbg_on)
-                        log_size += sprintf(log_buf + log_size, "Activate bank #%d, row #%d @ %llu ps\n", ba, addr, ts);
-                            
-                    if (row_act[ba])
-                    {
-                        printf("ERROR @ %llu ps : bank %d already active !\n", ts, ba);
-                        break;
-                    }
-                       
-                    row_act[ba]  = 1;
-                    row_pre[ba]  = 0;
-                    row_addr[ba] = (int)addr << bit_cols;
-                    
-                    break;
-                }
-                // 100 : Write
-                case CMD_WR:
-                {
-                    // Mask out extra bits
-                    addr &= (mask_cols >> bus_log2);
-                    
-                    if (dbg_on)
-                        log_size += sprintf(log_buf + log_size, "Write bank #%d, col #%d @ %llu ps\n", ba, addr, ts);
-                    
-                    if (!row_act[ba])
-                    {
-                        printf("ERROR @ %llu ps : bank %d is not activated for WRITE !\n", ts, ba);
-                        break;
-                    }
-                       
-                    // Latch command right away
-                    cmd_pipe[0] = CMD_WR;
-                    col_pipe[0] = (int)addr;
-                    ba_pipe[0]  = ba;
-
-                    // Auto-precharge
-                    ap_bank[ba] = a10;
-                    
-                    break;
-                }
-                // 101 : Read
-                case CMD_RD:
-                {
-                    // Mask out extra bits
-                    addr &= (mask_cols >> bus_log2);
-                    
-                    if (dbg_on)
-                        log_size += sprintf(log_buf + log_size, "Read bank #%d, col #%d @ %llu ps\n", ba, addr, ts);
-                    
-                    if (!row_act[ba])
-                    {
-                        printf("ERROR @ %llu ps : bank %d is not activated for READ !\n", ts, ba);
-                        break;
-                    }
-                       
-                    // CAS latency pipeline
-                    if (cas_lat)
-                    {
-                        cmd_pipe[cas_lat] = CMD_RD;
-                        col_pipe[cas_lat] = (int)addr;
-                        ba_pipe[cas_lat]  = ba;
-                    }
-                    
-                    // Auto-precharge
-                    ap_bank[ba] = a10;
-                    
-                    break;
-                }
-                // 110 : Burst stop
-                case CMD_BST:
-                {
-                    if (dbg_on)
-                        log_size += sprintf(log_buf + log_size, "Burst Stop bank #%d @ %llu ps\n", ba, ts);
-                        
-                    if (ap_bank[ba])
-                    {
-                        printf("ERROR @ %llu ps : cannot apply a burst stop to auto-precharged bank %d !\n", ts, ba);
-                        break;
-                    }
-                        
-                    // Terminate a WRITE immediately
-                    bst_ctr_wr = (vluint16_t)0;
-                    
-                    // CAS latency for READ
-                    if (cas_lat)
-                    {
-                        cmd_pipe[cas_lat] = CMD_BST;
-                    }
-                    break;
-                }
-                // 111 : No operation
-                default: ;
+                printf("Load Std Mode Register @ %llu ps\n", ts);
+                trace(ts, TRC_LMR, 0, addr, 0, 0);
             }
-            
-            // Process SDRAM command (pipelined)
-            switch (cmd_pipe[0])
+                
+            // CAS latency
+            switch((addr >> 4) & 7)
             {
-                // 010 : Precharge
-                case CMD_PRE:
-                {
-                    if ((a10_pipe[0]) || (bap_pipe[0] == (vluint8_t)bank))
-                        bst_ctr_rd = (int)0;
-                    break;
-                }
-                // 100 : Write
-                case CMD_WR:
+                case 2:
                 {
-                    // Bank, row and column addresses in memory array
-                    bank       = (int)ba_pipe[0];
-                    row        = row_addr[bank] + (col_pipe[0] & ~(bst_len_wr - 1));
-                    col        = col_pipe[0] & (bst_len_wr - 1);
-                    bst_ctr_rd = (int)0;
-                    bst_ctr_wr = bst_len_wr;
-                    
-                    if (dbg_on)
+                    if (DBG)
                     {
-                        if (mem_flags & FLAG_BANK_INTERLEAVING)
-                            fprintf(fh_log, "%08X : ", ((row_addr[bank] << SDRAM_BIT_BANKS) + (bank << bit_cols) + col_pipe[0]) << bus_log2);
-                        else
-                            fprintf(fh_log, "%08X : ", (row_addr[bank] + (bank << (bit_rows + bit_cols)) + col_pipe[0]) << bus_log2);
+                        printf("CAS latency        = 2 cycles\n");
                     }
-                    
+                    cas_lat = (int)2;
                     break;
                 }
-                // 101 : Read
-                case CMD_RD:
+                case 3:
                 {
-                    if (dbg_on)
-                    {
-                        if (bst_ctr_rd) fprintf(fh_log, "\n");
-                        if (log_size) fprintf(fh_log, log_buf);
-                        log_size = 0;
-                    }
-                        
-                    // Bank, row and column addresses in memory array
-                    bank       = (int)ba_pipe[0];
-                    row        = row_addr[bank] + (col_pipe[0] & ~(bst_len_rd - 1));
-                    col        = col_pipe[0] & (bst_len_rd - 1);
-                    bst_ctr_rd = bst_len_rd;
-                    bst_ctr_wr = (int)0;
-                    
-                    if (dbg_on)
+                    if (DBG)
                     {
-                        if (mem_flags & FLAG_BANK_INTERLEAVING)
-                            fprintf(fh_log, "%08X : ", ((row_addr[bank] << SDRAM_BIT_BANKS) + (bank << bit_cols) + col_pipe[0]) << bus_log2);
-                        else
-                            fprintf(fh_log, "%08X : ", (row_addr[bank] + (bank << (bit_rows + bit_cols)) + col_pipe[0]) << bus_log2);
+                        printf("CAS latency        = 3 cycles\n");
                     }
-                    
+                    cas_lat = (int)3;
                     break;
                 }
-                // 110 : Burst stop
-                case CMD_BST:
+                default:
                 {
-                    bst_ctr_rd = (int)0;
-                    break;
+                    if (DBG)
+                    {
+                        printf("CAS latency        = ???\n");
+                    }
+                    cas_lat = (int)0; // This disables pipelined commands
                 }
-                // 111 : No operation
-                default: ;
             }
             
-            // Write to memory
-            if (bst_ctr_wr)
+            // Burst length
+            switch (addr & 7)
             {
-                // Write MSL (if present)
-                if (mem_flags & DATA_MSL)
+                case 0:
                 {
-                    if (dqm & 0x80)
-                    {
-                        if (dbg_on) fprintf(fh_log, "XX");
-                    }
-                    else
-                    {
-                        mem_array_7[bank][row + col] = (vluint8_t)(dq_in >> 56);
-                        if (dbg_on) fprintf(fh_log, "%02X", mem_array_7[bank][row + col]);
-                    }
-                    if (dqm & 0x40)
-                    {
-                        if (dbg_on) fprintf(fh_log, "XX");
-                    }
-                    else
-                    {
-                        mem_array_6[bank][row + col] = (vluint8_t)(dq_in >> 48);
-                        if (dbg_on) fprintf(fh_log, "%02X", mem_array_6[bank][row + col]);
-                    }
-                    if (dqm & 0x20)
-                    {
-                        if (dbg_on) fprintf(fh_log, "XX");
-                    }
-                    else
-                    {
-                        mem_array_5[bank][row + col] = (vluint8_t)(dq_in >> 40);
-                        if (dbg_on) fprintf(fh_log, "%02X", mem_array_5[bank][row + col]);
-                    }
-                    if (dqm & 0x10)
+                    if (DBG)
                     {
-                        if (dbg_on) fprintf(fh_log, "XX");
-                    }
-                    else
-                    {
-                        mem_array_4[bank][row + col] = (vluint8_t)(dq_in >> 32);
-                        if (dbg_on) fprintf(fh_log, "%02X", mem_array_4[bank][row + col]);
+                        printf("Read burst length  = 1 word\n");
                     }
+                    bst_len_rd = (int)1;
+                    break;
                 }
-                // Write MSW (if present)
-                if (mem_flags & DATA_MSW)
+                case 1:
                 {
-                    if (dqm & 0x08)
+                    if (DBG)
                     {
-                        if (dbg_on) fprintf(fh_log, "XX");
+                        printf("Read burst length  = 2 words\n");
                     }
-                    else
-                    {
-                        mem_array_3[bank][row + col] = (vluint8_t)(dq_in >> 24);
-                        if (dbg_on) fprintf(fh_log, "%02X", mem_array_3[bank][row + col]);
-                    }
-                    if (dqm & 0x04)
+                    bst_len_rd = (int)2;
+                    break;
+                }
+                case 2:
+                {
+                    if (DBG)
                     {
-                        if (dbg_on) fprintf(fh_log, "XX");
+                        printf("Read burst length  = 4 words\n");
                     }
-                    else
+                    bst_len_rd = (int)4;
+                    break;
+                }
+                case 3:
+                {
+                    if (DBG)
                     {
-                        mem_array_2[bank][row + col] = (vluint8_t)(dq_in >> 16);
-                        if (dbg_on) fprintf(fh_log, "%02X", mem_array_2[bank][row + col]);
+                        printf("Read burst length  = 8 words\n");
                     }
+                    bst_len_rd = (int)8;
+                    break;
                 }
-                // Write MSB (if present)
-                if (mem_flags & DATA_MSB)
+                case 7:
                 {
-                    if (dqm & 0x02)
+                    if (DBG)
                     {
-                        if (dbg_on) fprintf(fh_log, "XX");
+                        printf("Read burst length  = continuous\n");
                     }
-                    else
+                    bst_len_rd = (int)num_cols;
+                    break;
+                }
+                default:
+                {
+                    if (DBG)
                     {
-                        mem_array_1[bank][row + col] = (vluint8_t)(dq_in >> 8);
-                        if (dbg_on) fprintf(fh_log, "%02X", mem_array_1[bank][row + col]);
+                        printf("Read burst length  = ???\n");
                     }
+                    bst_len_rd = (int)0; // This will disable burst read
                 }
-                // Write LSB
-                if (dqm & 0x01)
+            }
+            
+            // Burst type
+            if (addr & 8)
+            {
+                if (DBG)
                 {
-                    if (dbg_on) fprintf(fh_log, "XX ");
+                    printf("Burst type         = interleaved (NOT SUPPORTED !)\n");
                 }
-                else
-                {
-                    mem_array_0[bank][row + col] = (vluint8_t)dq_in;
-                    if (dbg_on) fprintf(fh_log, "%02X ", mem_array_0[bank][row + col]);
-                }                    
-                
-                // Burst counter (only sequential burst supported)
-                col = (col + 1) & (bst_len_wr - 1);
-                bst_ctr_wr--;
-                
-                // End of burst
-                if (bst_ctr_wr == (int)0)
+                bst_type = (vluint8_t)1;
+            }
+            else
+            {
+                if (DBG)
                 {
-                    // Auto-precharge case
-                    if (ap_bank[bank])
-                    {
-                        if (dbg_on) fprintf(fh_log, "PRE\n\n");
-                        ap_bank[bank] = (vluint8_t)0;
-                        row_act[bank] = (vluint8_t)0;
-                        row_pre[bank] = (vluint8_t)1;
-                    }
-                    else
-                    {
-                        if (dbg_on) fprintf(fh_log, "\n");
-                    }
-                    if (log_size)
-                    {
-                        fprintf(fh_log, log_buf);
-                        log_size = 0;
-                    }
+                    printf("Burst type         = sequential\n");
                 }
+                bst_type = (vluint8_t)0;
             }
             
-            // Read from memory
-            if (bst_ctr_rd)
+            // Write burst
+            if (addr & 0x200)
             {
-                vluint8_t dq_tmp[8];
-                
-                dq_tmp[7] = (vluint8_t)0x00;
-                dq_tmp[6] = (vluint8_t)0x00;
-                dq_tmp[5] = (vluint8_t)0x00;
-                dq_tmp[4] = (vluint8_t)0x00;
-                dq_tmp[3] = (vluint8_t)0x00;
-                dq_tmp[2] = (vluint8_t)0x00;
-                dq_tmp[1] = (vluint8_t)0x00;
-                dq_tmp[0] = (vluint8_t)0x00;
-                
-                // Read MSL (if present)
-                if (mem_flags & DATA_MSL)
+                if (DBG)
                 {
-                    if (dqm_pipe[0] & 0x80)
-                    {
-                        if (dbg_on) fprintf(fh_log, "XX");
-                    }
-                    else
-                    {
-                        dq_tmp[7] = mem_array_7[bank][row + col];
-                        if (dbg_on) fprintf(fh_log, "%02X", dq_tmp[7]);
-                    }
-                    if (dqm_pipe[0] & 0x40)
-                    {
-                        if (dbg_on) fprintf(fh_log, "XX");
-                    }
-                    else
-                    {
-                        dq_tmp[6] = mem_array_6[bank][row + col];
-                        if (dbg_on) fprintf(fh_log, "%02X", dq_tmp[6]);
-                    }
-                    if (dqm_pipe[0] & 0x20)
-                    {
-                        if (dbg_on) fprintf(fh_log, "XX");
-                    }
-                    else
-                    {
-                        dq_tmp[5] = mem_array_5[bank][row + col];
-                        if (dbg_on) fprintf(fh_log, "%02X", dq_tmp[5]);
-                    }
-                    if (dqm_pipe[0] & 0x10)
-                    {
-                        if (dbg_on) fprintf(fh_log, "XX");
-                    }
-                    else
-                    {
-                        dq_tmp[4] = mem_array_4[bank][row + col];
-                        if (dbg_on) fprintf(fh_log, "%02X", dq_tmp[4]);
-                    }
+                    printf("Write burst length = 1\n");
                 }
-                
-                // Read MSW (if present)
-                if (mem_flags & DATA_MSW)
+                bst_len_wr = (int)1;
+            }
+            else
+            {
+                if (DBG)
                 {
-                    if (dqm_pipe[0] & 0x08)
-                    {
-                        if (dbg_on) fprintf(fh_log, "XX");
-                    }
-                    else
-                    {
-                        dq_tmp[3] = mem_array_3[bank][row + col];
-                        if (dbg_on) fprintf(fh_log, "%02X", dq_tmp[3]);
-                    }
-                    if (dqm_pipe[0] & 0x04)
+                    if (bst_len_rd)
                     {
-                        if (dbg_on) fprintf(fh_log, "XX");
+                        if (bst_len_rd <= (int)8)
+                        {
+                            printf("Write burst length = %d word(s)\n", bst_len_rd);
+                        }
+                        else
+                        {
+                            printf("Write burst length = continuous\n");
+                        }
                     }
                     else
                     {
-                        dq_tmp[2] = mem_array_2[bank][row + col];
-                        if (dbg_on) fprintf(fh_log, "%02X", dq_tmp[2]);
+                        // This disables burst write
+                        printf("Write burst length = ???\n");
                     }
                 }
+                bst_len_wr = bst_len_rd;
+            }
+            break;
+        }
+        // 001 : Auto refresh
+        case CMD_REF:
+        {
+            if (DBG) trace(ts, TRC_REF, 0, 0, 0, 0);
+            
+            for (int i = 0; i < SDRAM_NUM_BANKS; i++)
+            {
+                if (!row_pre[i])
+                {
+                    printf("ERROR @ %llu ps : All banks must be Precharge before Auto Refresh\n", ts);
+                    err_cnt++;
+                    break;
+                }
+            }
+            break;
+        }
+        // 010 : Precharge
+        case CMD_PRE:
+        {
+            if (a10)
+            {
+                if (DBG) trace(ts, TRC_PRE, 0, 1, 0, 0);
                 
-                // Read MSB (if present)
-                if (mem_flags & DATA_MSB)
+                if (ap_bank[0] || ap_bank[1] || ap_bank[2] || ap_bank[3])
                 {
-                    if (dqm_pipe[0] & 0x02)
-                    {
-                        if (dbg_on) fprintf(fh_log, "XX");
-                    }
-                    else
-                    {
-                        dq_tmp[1] = mem_array_1[bank][row + col];
-                        if (dbg_on) fprintf(fh_log, "%02X", dq_tmp[1]);
-                    }
+                    printf("ERROR @ %llu ps : at least one bank is auto-precharged !\n", ts);
+                    err_cnt++;
+                    break;
                 }
-
-                // Read LSB
-                if (dqm_pipe[0] & 0x01)
+                
+                // Precharge all banks
+                for (int i = 0; i < SDRAM_NUM_BANKS; i++)
                 {
-                    if (dbg_on) fprintf(fh_log, "XX ");
+                    row_act[i] = 0;
+                    row_pre[i] = 1;
                 }
-                else
+            }
+            else
+            {
+                if (DBG) trace(ts, TRC_PRE, ba, 0, 0, 0);
+                    
+                if (ap_bank[ba])
                 {
-                    dq_tmp[0] = mem_array_0[bank][row + col];
-                    if (dbg_on) fprintf(fh_log, "%02X ", dq_tmp[0]);
+                    printf("ERROR @ %llu ps : cannot apply a precharge to auto-precharged bank %d !\n", ts, ba);
+                    err_cnt++;
+                    break;
                 }
                 
-                dq_out = ((vluint64_t)dq_tmp[0]      )
-                       | ((vluint64_t)dq_tmp[1] << 8 )
-                       | ((vluint64_t)dq_tmp[2] << 16)
-                       | ((vluint64_t)dq_tmp[3] << 24)
-                       | ((vluint64_t)dq_tmp[4] << 32)
-                       | ((vluint64_t)dq_tmp[5] << 40)
-                       | ((vluint64_t)dq_tmp[6] << 48)
-                       | ((vluint64_t)dq_tmp[7] << 56);
+                // Precharge one bank
+                row_act[ba] = 0;
+                row_pre[ba] = 1;
+            }
+            
+            // Terminate a WRITE immediately
+            if ((a10) || (bank == (int)ba))
+                bst_ctr_wr = 0;
+            
+            // CAS latency pipeline for READ
+            if (cas_lat)
+            {
+                cmd_pipe[cas_lat] = CMD_PRE;
+                bap_pipe[cas_lat] = ba;
+                a10_pipe[cas_lat] = a10;
+            }
+            
+            break;
+        }
+        // 011 : Activate
+        case CMD_ACT:
+        {
+            // Mask out extra bits
+            addr &= (num_rows - 1);
+            
+            if (DBG) trace(ts, TRC_ACT, ba, addr, 0, 0);
+                    
+            if (row_act[ba])
+            {
+                printf("ERROR @ %llu ps : bank %d already active !\n", ts, ba);
+                err_cnt++;
+                break;
+            }
+               
+            row_act[ba]  = 1;
+            row_pre[ba]  = 0;
+            row_addr[ba] = (int)addr << bit_cols;
+            
+            break;
+        }
+        // 100 : Write
+        case CMD_WR:
+        {
+            // Mask out extra bits
+            addr &= (mask_cols >> bus_log2);
+            
+            if (DBG) trace(ts, TRC_WR, ba, addr, 0, 0);
+            
+            if (!row_act[ba])
+            {
+                printf("ERROR @ %llu ps : bank %d is not activated for WRITE !\n", ts, ba);
+                err_cnt++;
+                break;
+            }
+               
+            // Latch command right away
+            cmd_pipe[0] = CMD_WR;
+            col_pipe[0] = (int)addr;
+            ba_pipe[0]  = ba;
+
+            // Auto-precharge
+            ap_bank[ba] = a10;
+            
+            break;
+        }
+        // 101 : Read
+        case CMD_RD:
+        {
+            // Mask out extra bits
+            addr &= (mask_cols >> bus_log2);
+            
+            if (DBG) trace(ts, TRC_RD, ba, addr, 0, 0);
+            
+            if (!row_act[ba])
+            {
+                printf("ERROR @ %llu ps : bank %d is not activated for READ !\n", ts, ba);
+                err_cnt++;
+                break;
+            }
+               
+            // CAS latency pipeline
+            if (cas_lat)
+            {
+                cmd_pipe[cas_lat] = CMD_RD;
+                col_pipe[cas_lat] = (int)addr;
+                ba_pipe[cas_lat]  = ba;
+            }
+            
+            // Auto-precharge
+            ap_bank[ba] = a10;
+            
+            break;
+        }
+        // 110 : Burst stop
+        case CMD_BST:
+        {
+            if (DBG) trace(ts, TRC_BST, ba, 0, 0, 0);
                 
-                // Burst counter (only sequential supported)
-                col = (col + 1) & (bst_len_rd - 1);
-                bst_ctr_rd--;
+            if (ap_bank[ba])
+            {
+                printf("ERROR @ %llu ps : cannot apply a burst stop to auto-precharged bank %d !\n", ts, ba);
+                err_cnt++;
+                break;
+            }
                 
-                // End of burst
-                if (bst_ctr_rd == (int)0)
-                {
-                    // Auto-precharge case
-                    if (ap_bank[bank])
-                    {
-                        if (dbg_on) fprintf(fh_log, "PRE\n");
-                        ap_bank[bank] = (vluint8_t)0;
-                        row_act[bank] = (vluint8_t)0;
-                        row_pre[bank] = (vluint8_t)1;
-                    }
-                    else
-                    {
-                        if (dbg_on) fprintf(fh_log, "\n");
-                    }
-                    if (log_size)
-                    {
-                        fprintf(fh_log, log_buf);
-                        log_size = 0;
-                    }
-                }
+            // Terminate a WRITE immediately
+            bst_ctr_wr = (vluint16_t)0;
+            
+            // CAS latency for READ
+            if (cas_lat)
+            {
+                cmd_pipe[cas_lat] = CMD_BST;
             }
+            break;
         }
-        
-        if ((bst_ctr_wr == (int)0) && (bst_ctr_rd == (int)0) && (log_size != (int)0))
+        // 111 : No operation
+        default: ;
+    }
+    
+    // Process SDRAM command (pipelined)
+    switch (cmd_pipe[0])
+    {
+        // 010 : Precharge
+        case CMD_PRE:
+        {
+            if ((a10_pipe[0]) || (bap_pipe[0] == (vluint8_t)bank))
+                bst_ctr_rd = (int)0;
+            break;
+        }
+        // 100 : Write
+        case CMD_WR:
+        {
+            // Bank, row and column addresses in memory array
+            bank       = (int)ba_pipe[0];
+            row        = row_addr[bank] + (col_pipe[0] & ~(bst_len_wr - 1));
+            col        = col_pipe[0] & (bst_len_wr - 1);
+            bst_ctr_rd = (int)0;
+            bst_ctr_wr = bst_len_wr;
+            
+            if (DBG)
+            {
+                if (ILV)
+                    trace(ts, TRC_WR_BURST, (vluint8_t)bank, (vluint16_t)col_pipe[0], 0,
+                          ((row_addr[bank] << SDRAM_BIT_BANKS) + (bank << bit_cols) + col_pipe[0]) << bus_log2);
+                else
+                    trace(ts, TRC_WR_BURST, (vluint8_t)bank, (vluint16_t)col_pipe[0], 0,
+                          (row_addr[bank] + (bank << (bit_rows + bit_cols)) + col_pipe[0]) << bus_log2);
+            }
+            
+            break;
+        }
+        // 101 : Read
+        case CMD_RD:
+        {
+            // Bank, row and column addresses in memory array
+            bank       = (int)ba_pipe[0];
+            row        = row_addr[bank] + (col_pipe[0] & ~(bst_len_rd - 1));
+            col        = col_pipe[0] & (bst_len_rd - 1);
+            bst_ctr_rd = bst_len_rd;
+            bst_ctr_wr = (int)0;
+            
+            if (DBG)
+            {
+                if (ILV)
+                    trace(ts, TRC_RD_BURST, (vluint8_t)bank, (vluint16_t)col_pipe[0], 0,
+                          ((row_addr[bank] << SDRAM_BIT_BANKS) + (bank << bit_cols) + col_pipe[0]) << bus_log2);
+                else
+                    trace(ts, TRC_RD_BURST, (vluint8_t)bank, (vluint16_t)col_pipe[0], 0,
+                          (row_addr[bank] + (bank << (bit_rows + bit_cols)) + col_pipe[0]) << bus_log2);
+            }
+            
+            break;
+        }
+        // 110 : Burst stop
+        case CMD_BST:
+        {
+            bst_ctr_rd = (int)0;
+            break;
+        }
+        // 111 : No operation
+        default: ;
+    }
+    
+    // Write to memory
+    if (bst_ctr_wr)
+    {
+        if (WORD)
         {
-            fprintf(fh_log, log_buf);
-            log_size = 0;
+            vluint64_t wr_mask = dqm_mask[dqm];
+            
+            // One word : DQM applied as a mask
+            ((word_t *)mem_bank[bank])[row + col] =
+                (word_t)(((vluint64_t)((word_t *)mem_bank[bank])[row + col] & ~wr_mask) | (dq_in & wr_mask));
+        }
+        else
+        {
+            // Write MSL (if present)
+            if (BUS_LOG2 >= 3)
+            {
+                if (!(dqm & 0x80)) mem_array_7[bank][row + col] = (vluint8_t)(dq_in >> 56);
+                if (!(dqm & 0x40)) mem_array_6[bank][row + col] = (vluint8_t)(dq_in >> 48);
+                if (!(dqm & 0x20)) mem_array_5[bank][row + col] = (vluint8_t)(dq_in >> 40);
+                if (!(dqm & 0x10)) mem_array_4[bank][row + col] = (vluint8_t)(dq_in >> 32);
+            }
+            // Write MSW (if present)
+            if (BUS_LOG2 >= 2)
+            {
+                if (!(dqm & 0x08)) mem_array_3[bank][row + col] = (vluint8_t)(dq_in >> 24);
+                if (!(dqm & 0x04)) mem_array_2[bank][row + col] = (vluint8_t)(dq_in >> 16);
+            }
+            // Write MSB (if present)
+            if (BUS_LOG2 >= 1)
+            {
+                if (!(dqm & 0x02)) mem_array_1[bank][row + col] = (vluint8_t)(dq_in >> 8);
+            }
+            // Write LSB
+            if (!(dqm & 0x01)) mem_array_0[bank][row + col] = (vluint8_t)dq_in;
+        }
+        if (DBG) trace(ts, TRC_WR_DATA, (vluint8_t)bank, (vluint16_t)col, dqm, dq_in & dqm_mask[dqm]);
+        if (PRF)
+        {
+            prf_frame.wr[bank]++;
+            beats++;
+            if (heat_on) heat_wr[heat_addr<ILV>() >> heat_page_log2]++;
+            tmg_wr[bank] = tmg_cyc;
         }
         
-        // For edge detection
-        prev_clk = clk;
+        // Burst counter (only sequential burst supported)
+        col = (col + 1) & (bst_len_wr - 1);
+        bst_ctr_wr--;
+        
+        // End of burst
+        if (bst_ctr_wr == (int)0)
+        {
+            // Auto-precharge case
+            if (ap_bank[bank])
+            {
+                if (DBG) trace(ts, TRC_WR_END, (vluint8_t)bank, 1, 0, 0);
+                // Precharge started tWR after the last data
+                if (PRF) tmg_pre[bank] = tmg_cyc + (vluint64_t)tmg_min[TMG_WR];
+                ap_bank[bank] = (vluint8_t)0;
+                row_act[bank] = (vluint8_t)0;
+                row_pre[bank] = (vluint8_t)1;
+            }
+            else
+            {
+                if (DBG) trace(ts, TRC_WR_END, (vluint8_t)bank, 0, 0, 0);
+            }
+        }
     }
-    // Clock disabled
-    else
+    
+    // Read from memory
+    if (bst_ctr_rd)
     {
-        prev_clk = (vluint8_t)0;
+        vluint64_t dq_tmp;
+        
+        if (WORD)
+        {
+            // One word
+            dq_tmp = (vluint64_t)((word_t *)mem_bank[bank])[row + col];
+        }
+        else
+        {
+            // Read LSB
+            dq_tmp = (vluint64_t)mem_array_0[bank][row + col];
+            // Read MSB (if present)
+            if (BUS_LOG2 >= 1)
+            {
+                dq_tmp |= (vluint64_t)mem_array_1[bank][row + col] << 8;
+            }
+            // Read MSW (if present)
+            if (BUS_LOG2 >= 2)
+            {
+                dq_tmp |= (vluint64_t)mem_array_2[bank][row + col] << 16;
+                dq_tmp |= (vluint64_t)mem_array_3[bank][row + col] << 24;
+            }
+            // Read MSL (if present)
+            if (BUS_LOG2 >= 3)
+            {
+                dq_tmp |= (vluint64_t)mem_array_4[bank][row + col] << 32;
+                dq_tmp |= (vluint64_t)mem_array_5[bank][row + col] << 40;
+                dq_tmp |= (vluint64_t)mem_array_6[bank][row + col] << 48;
+                dq_tmp |= (vluint64_t)mem_array_7[bank][row + col] << 56;
+            }
+        }
+        // DQM applied as a mask
+        dq_out = dq_tmp & dqm_mask[dqm_pipe[0]];
+        if (DBG) trace(ts, TRC_RD_DATA, (vluint8_t)bank, (vluint16_t)col, dqm_pipe[0], dq_out);
+        if (PRF)
+        {
+            prf_frame.rd[bank]++;
+            beats++;
+            if (heat_on) heat_rd[heat_addr<ILV>() >> heat_page_log2]++;
+        }
+        
+        // Burst counter (only sequential supported)
+        col = (col + 1) & (bst_len_rd - 1);
+        bst_ctr_rd--;
+        
+        // End of burst
+        if (bst_ctr_rd == (int)0)
+        {
+            // Auto-precharge case
+            if (ap_bank[bank])
+            {
+                if (DBG) trace(ts, TRC_RD_END, (vluint8_t)bank, 1, 0, 0);
+                // Precharge started at the end of the burst, before the CAS latency
+                if (PRF) tmg_pre[bank] = tmg_cyc + 1 - (vluint64_t)cas_lat;
+                ap_bank[bank] = (vluint8_t)0;
+                row_act[bank] = (vluint8_t)0;
+                row_pre[bank] = (vluint8_t)1;
+            }
+            else
+            {
+                if (DBG) trace(ts, TRC_RD_END, (vluint8_t)bank, 0, 0, 0);
+            }
+        }
     }
+    
+    // Bandwidth profiler (data bus, video lines)
+    if (PRF) prof_cycle(ts, cmd, beats);
 }
 
 // Read a byte, interleaved banks, big endian, 8-bit SDRAM
@@ -1631,3 +2634,27 @@ vluint8_t SDRAM::read_byte_c_le_64(vluint32_t addr)
         case 7 : return mem_array_7[bank_nr][idx];
     }
 }
+
+// Read a byte, interleaved banks, word-wide storage
+vluint8_t SDRAM::read_byte_i_w(vluint32_t addr)
+{
+    int        bank_nr;  // Bank number (0 to 3)
+    int        idx;      // Array index (0 to num_cols * num_rows - 1)
+    
+    bank_nr = (int)(addr & mask_bank) >> (bit_cols + bus_log2);
+    idx     = (int)((addr & mask_cols) | ((addr & mask_rows) >> SDRAM_BIT_BANKS)) >> bus_log2;
+
+    return (vluint8_t)(get_word(bank_nr, idx) >> ((((int)addr & bus_mask) ^ lane_swap) << 3));
+}
+
+// Read a byte, contiguous banks, word-wide storage
+vluint8_t SDRAM::read_byte_c_w(vluint32_t addr)
+{
+    int        bank_nr;  // Bank number (0 to 3)
+    int        idx;      // Array index (0 to num_cols * num_rows - 1)
+    
+    bank_nr = (int)(addr & mask_bank) >> (bit_cols + bit_rows + bus_log2);
+    idx     = (int)(addr & (mask_cols | mask_rows)) >> bus_log2;
+
+    return (vluint8_t)(get_word(bank_nr, idx) >> ((((int)addr & bus_mask) ^ lane_swap) << 3));
+}
@@ -22,9 +22,15 @@
 //  - 8/16/32-bit data bus supported
 //  - 4 banks only
 //  - Two memory layouts : interleaved banks or contiguous banks
+//  - Two storage backends : byte lanes arrays or word-wide arrays
 //  - Sequential burst only, no interleaved burst yet
 //  - Binary images can be loaded to and saved from SDRAM
-//  - Debug mode to trace every SDRAM access
+//  - Whole SDRAM images can be saved and mapped back (copy-on-write)
+//  - Debug mode to trace every SDRAM access (buffered binary trace)
+//  - Cycle evaluation specialized for each configuration (no per-cycle flag tests)
+//  - Bandwidth profiler : per bank and per video line accesses (per-frame CSV)
+//  - Access heatmap : reads and writes per address page and per named region
+//  - Timing checker : tRCD, tRP, tRAS, tRC, tWR, tRFC and refresh interval (min slack)
 //  - Endianness support for 16 and 32-bit memories
 //
 // TODO:
@@ -34,11 +40,30 @@
 #define _SDR_SDRAM_H_
 
 #include "verilated.h"
+#include "sdr_trace.h"
+#if VM_SAVABLE
+#include "verilated_save.h"
+#endif /* VM_SAVABLE */
 
 #define SDRAM_NUM_BANKS        (4)
 #define SDRAM_BIT_BANKS        (2)
 #define CMD_PIPE_DEPTH         (4)
 #define DQM_PIPE_DEPTH         (2)
+#define TRACE_BUF_SIZE         (65536)
+#define PROF_HIST_SIZE         (11)
+#define HEAT_MAX_REGIONS       (16)
+#define TMG_MAX_PRINTS         (16)
+#define IMAGE_MAX_SOURCES      (64)
+
+// Timing parameters
+#define TMG_RCD                (0)
+#define TMG_RP                 (1)
+#define TMG_RAS                (2)
+#define TMG_RC                 (3)
+#define TMG_WR                 (4)
+#define TMG_RFC                (5)
+#define TMG_REFI               (6)
+#define TMG_NUM                (7)
 
 #define FLAG_DATA_WIDTH_8      ((vluint8_t)0x00)
 #define FLAG_DATA_WIDTH_16     ((vluint8_t)0x01)
@@ -48,26 +73,105 @@
 #define FLAG_BIG_ENDIAN        ((vluint8_t)0x10)
 #define FLAG_RANDOM_FILLED     ((vluint8_t)0x20)
 #define FLAG_DEBUG_ON          ((vluint8_t)0x40)
+#define FLAG_WORD_STORAGE      ((vluint8_t)0x80)
+
+// Preloaded SDRAM image header
+typedef struct
+{
+    char       magic[8];                         // "SDRIMG02"
+    vluint32_t bit_rows;                         // Number of rows (log 2)
+    vluint32_t bit_cols;                         // Number of columns (log 2)
+    vluint32_t flags;                            // Data width, banks layout, endianness
+    vluint32_t num_src;                          // Number of binary files loaded (table after the header)
+    vluint64_t size;                             // Memory arrays size (in bytes)
+} sdram_image_hdr;
+
+// Binary file loaded into a preloaded SDRAM image (the image is stale once it changes)
+typedef struct
+{
+    char       name[240];                        // File name
+    vluint64_t size;                             // File size (in bytes)
+    vluint64_t mtime;                            // Modification time (in ns)
+} sdram_image_src;
+
+// Timing parameters (in clock cycles)
+typedef struct
+{
+    int        rcd;                              // ACTIVE to READ/WRITE
+    int        rp;                               // PRECHARGE to ACTIVE/REFRESH
+    int        ras;                              // ACTIVE to PRECHARGE
+    int        rc;                               // ACTIVE to ACTIVE (same bank)
+    int        wr;                               // Last write data to PRECHARGE
+    int        rfc;                              // REFRESH to ACTIVE/REFRESH
+    int        refi;                             // Average refresh interval (8 refreshes can be postponed)
+} sdram_timing;
+
+// Bandwidth profiler counters
+typedef struct
+{
+    vluint64_t cycles;                           // Clock cycles
+    vluint64_t lines;                            // Video lines
+    vluint64_t idle;                             // Cycles without data on the bus
+    vluint64_t nop;                              // Cycles without command
+    vluint64_t ref;                              // Auto refreshes
+    vluint64_t act[SDRAM_NUM_BANKS];             // Activates
+    vluint64_t rd[SDRAM_NUM_BANKS];              // Read beats
+    vluint64_t wr[SDRAM_NUM_BANKS];              // Write beats
+    vluint64_t hit[SDRAM_NUM_BANKS];             // Accesses to a row already accessed
+    vluint64_t miss[SDRAM_NUM_BANKS];            // First accesses after an activate
+    vluint64_t pre[SDRAM_NUM_BANKS];             // Precharges (explicit or auto)
+    int        peak[SDRAM_NUM_BANKS];            // Accesses during the busiest line
+} sdram_prof;
 
 class SDRAM
 {
     public:
         // Constructor and destructor
-        SDRAM(vluint8_t log2_rows, vluint8_t log2_cols, vluint8_t flags, char *logfile);
+        SDRAM(vluint8_t log2_rows, vluint8_t log2_cols, vluint8_t flags, char *logfile, const char *image = NULL);
         ~SDRAM();
         // Methods
         void load(const char *name, vluint32_t size,  vluint32_t addr);
         void save(const char *name, vluint32_t size,  vluint32_t addr);
+        bool save_image(const char *name);
+        bool image_mapped();
+        void fork_trace(int child_nr);
+        int  get_errors();
+        void set_profile(const char *csv_file, int line_cycles, int line_slots);
+        void prof_frame(int frame_nr);
+        void add_region(const char *name, vluint32_t addr, vluint32_t size);
+        void set_heatmap(const char *prefix, int page_log2);
+        void heat_frame(int frame_nr);
+        void set_timing(const sdram_timing *tmg);
+#if VM_SAVABLE
+        void save_state(VerilatedSerialize &os);
+        bool restore_state(VerilatedDeserialize &is);
+#endif /* VM_SAVABLE */
         void eval(vluint64_t ts,    vluint8_t clk,    vluint8_t  cke,
                   vluint8_t  cs_n,  vluint8_t ras_n,  vluint8_t  cas_n, vluint8_t we_n,
                   vluint8_t  ba,    vluint16_t addr,
                   vluint8_t  dqm,   vluint64_t dq_in, vluint64_t &dq_out);
+        void eval_posedge(vluint64_t ts,
+                  vluint8_t  cs_n,  vluint8_t ras_n,  vluint8_t  cas_n, vluint8_t we_n,
+                  vluint8_t  ba,    vluint16_t addr,
+                  vluint8_t  dqm,   vluint64_t dq_in, vluint64_t &dq_out);
         vluint8_t  read_byte(vluint32_t addr);
         vluint16_t read_word(vluint32_t addr);
         vluint32_t read_long(vluint32_t addr);
         vluint64_t read_quad(vluint32_t addr);
         vluint32_t mem_size;
     private:
+        // Cycle evaluate kernels (to speedup evaluation)
+        typedef void (SDRAM::*eval_kernel_t)(vluint64_t, vluint8_t, vluint8_t, vluint8_t, vluint8_t,
+                                             vluint8_t, vluint16_t, vluint8_t, vluint64_t, vluint64_t &);
+        eval_kernel_t eval_priv;
+        void       select_kernel();
+        template <bool DBG, bool PRF>
+        eval_kernel_t pick_kernel();
+        template <int BUS_LOG2, bool WORD, bool ILV, bool DBG, bool PRF>
+        void       eval_kernel(vluint64_t ts,
+                  vluint8_t  cs_n,  vluint8_t ras_n,  vluint8_t  cas_n, vluint8_t we_n,
+                  vluint8_t  ba,    vluint16_t addr,
+                  vluint8_t  dqm,   vluint64_t dq_in, vluint64_t &dq_out);
         // Byte reading functions (to speedup access)
         vluint8_t  (SDRAM::*read_byte_priv)(vluint32_t);
         vluint8_t  read_byte_i_be_8(vluint32_t addr);
@@ -86,6 +190,34 @@ class SDRAM
         vluint8_t  read_byte_c_le_16(vluint32_t addr);
         vluint8_t  read_byte_c_le_32(vluint32_t addr);
         vluint8_t  read_byte_c_le_64(vluint32_t addr);
+        vluint8_t  read_byte_i_w(vluint32_t addr);
+        vluint8_t  read_byte_c_w(vluint32_t addr);
+        // Word-wide storage access
+        vluint64_t get_word(int bank_nr, int idx);
+        void       set_word(int bank_nr, int idx, vluint64_t data);
+        // Binary trace
+        void       trace(vluint64_t ts, vluint8_t type, vluint8_t ba, vluint16_t addr, vluint8_t dqm, vluint64_t data);
+        bool       trace_open(const char *name);
+        void       trace_flush();
+        // Bandwidth profiler
+        void       prof_cmd(vluint8_t cmd, vluint8_t ba, vluint8_t a10);
+        void       prof_cycle(vluint64_t ts, vluint8_t cmd, int beats);
+        void       prof_line();
+        void       prof_summary();
+        // Access heatmap
+        void       heat_summary();
+        // Timing checker
+        void       tmg_cmd(vluint64_t ts, vluint8_t cmd, vluint8_t ba, vluint8_t a10);
+        void       tmg_check(vluint64_t ts, int param, int bank, vluint64_t since, int min_cyc);
+        void       tmg_refi_late(vluint64_t ts);
+        void       tmg_slack_upd(vluint64_t ts, int param, int bank, int slack);
+        void       tmg_summary();
+        int        heat_region(int page);
+        template <bool ILV>
+        vluint32_t heat_addr();
+        // Binary image loading
+        void       load_words(const vluint8_t *src, int bank_nr, int idx, int words);
+        bool       map_image(const char *name);
         // SDRAM capacity
         int        bus_mask;                     // Data bus width (bytes - 1)
         int        bus_log2;                     // Data bus width (log2(bytes))
@@ -97,6 +229,11 @@ class SDRAM
         vluint32_t mask_rows;                    // Bit mask for rows
         vluint32_t mask_cols;                    // Bit mask for columns
         // Memory arrays
+        vluint8_t *mem_blk;                      // Single block for all the arrays
+        size_t     mem_blk_size;                 // Block size (in bytes)
+        bool       mem_mapped;                   // Block mapped from a preloaded image
+        int        img_src_cnt;                  // Binary files loaded (-1 : image cannot be saved)
+        sdram_image_src img_src[IMAGE_MAX_SOURCES];
         vluint8_t *mem_array_7[SDRAM_NUM_BANKS]; // MSB
         vluint8_t *mem_array_6[SDRAM_NUM_BANKS];
         vluint8_t *mem_array_5[SDRAM_NUM_BANKS];
@@ -105,6 +242,9 @@ class SDRAM
         vluint8_t *mem_array_2[SDRAM_NUM_BANKS];
         vluint8_t *mem_array_1[SDRAM_NUM_BANKS];
         vluint8_t *mem_array_0[SDRAM_NUM_BANKS]; // LSB
+        vluint8_t *mem_bank[SDRAM_NUM_BANKS];    // Word-wide arrays
+        int        lane_swap;                    // Byte lane swap (big endian)
+        vluint64_t dqm_mask[256];                // DQM to data bus mask
         // Mode register                         
         int        cas_lat;                      // CAS latency (2 or 3)
         int        bst_len_rd;                   // Burst length during read
@@ -131,10 +271,52 @@ class SDRAM
         int        col;                          // Current column during read/write
         int        bst_ctr_rd;                   // Burst counter (read)
         int        bst_ctr_wr;                   // Burst counter (write)
-        // Log file
+        int        err_cnt;                      // Protocol errors counter
+        // Trace file
         FILE      *fh_log;
-        char      *log_buf;
-        int        log_size;
+        char       trc_name[256];                // Trace file name
+        sdram_trace_rec *trc_buf;                // Records waiting to be written
+        int        trc_cnt;                      // Number of records in buffer
+        // Bandwidth profiler
+        FILE      *fh_prof;                      // Per-frame CSV file
+        int        prf_line_cyc;                 // Clock cycles per video line
+        int        prf_line_slots;               // Access slots per bank and per line
+        int        prf_cyc_ctr;                  // Cycles in the current line
+        int        prf_ref_gap;                  // Cycles since the last refresh (saturated)
+        int        prf_line_acc[SDRAM_NUM_BANKS];// Accesses during the current line
+        bool       prf_used[SDRAM_NUM_BANKS];    // Row accessed since its activation
+        sdram_prof prf_frame;                    // Current frame
+        sdram_prof prf_total;                    // Whole simulation
+        vluint64_t prf_hist[SDRAM_NUM_BANKS][PROF_HIST_SIZE]; // Lines per load (10 % steps)
+        // Access heatmap
+        bool       heat_on;
+        char       heat_name[256];               // Cumulative map file name
+        FILE      *fh_heat;                      // Per-frame CSV file
+        int        heat_page_log2;               // Page size (log 2)
+        int        heat_pages;                   // Number of pages
+        vluint32_t *heat_rd;                     // Reads per page (current frame)
+        vluint32_t *heat_wr;                     // Writes per page (current frame)
+        vluint64_t *heat_rd_tot;                 // Reads per page (whole simulation)
+        vluint64_t *heat_wr_tot;                 // Writes per page (whole simulation)
+        int        heat_reg_cnt;                 // Named regions (the last one is for the other pages)
+        char       heat_reg_name[HEAT_MAX_REGIONS + 1][32];
+        vluint32_t heat_reg_addr[HEAT_MAX_REGIONS];
+        vluint32_t heat_reg_size[HEAT_MAX_REGIONS];
+        // Timing checker
+        bool       tmg_on;
+        int        tmg_min[TMG_NUM];             // Timing parameters
+        vluint64_t tmg_cyc;                      // Clock cycles counter
+        vluint64_t tmg_act[SDRAM_NUM_BANKS];     // Last ACTIVE
+        vluint64_t tmg_pre[SDRAM_NUM_BANKS];     // Last precharge (explicit or auto)
+        vluint64_t tmg_wr[SDRAM_NUM_BANKS];      // Last write data
+        vluint64_t tmg_ref;                      // Last REFRESH
+        vluint64_t tmg_due;                      // Next refresh due
+        vluint64_t tmg_late;                     // Refresh overdue after this cycle (TMG_NONE : reported)
+        vluint64_t tmg_ts;                       // Time stamp of the last clock cycle
+        vluint64_t tmg_checks[TMG_NUM];          // Number of checks
+        vluint64_t tmg_viol[TMG_NUM];            // Number of violations
+        vluint64_t tmg_slack_ts[TMG_NUM];        // Time stamp of the minimal slack
+        int        tmg_slack[TMG_NUM];           // Minimal slack (in clock cycles)
 };
 
 #endif /* _SDR_SDRAM_H_ */
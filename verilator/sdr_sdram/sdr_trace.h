@@ -0,0 +1,70 @@
+// Copyright 2013 Frederic Requin
+//
+// This file is part of the MCC216 project (www.arcaderetrogaming.com)
+//
+// The SDRAM C++ model is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// The SDRAM C++ model is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// SDRAM binary trace format:
+// --------------------------
+//  - Written by the SDRAM C++ model in debug mode
+//  - One header followed by fixed size records (host byte order)
+//  - Decoded offline by "sdr_trace_dec"
+//
+
+#ifndef _SDR_TRACE_H_
+#define _SDR_TRACE_H_
+
+#include <stdint.h>
+
+#define TRC_MAGIC    "SDRTRC01"
+
+// Commands (same encoding as the SDRAM commands)
+#define TRC_LMR      (0)  // addr : mode register
+#define TRC_REF      (1)
+#define TRC_PRE      (2)  // ba, addr : 1 for all banks
+#define TRC_ACT      (3)  // ba, addr : row
+#define TRC_WR       (4)  // ba, addr : column
+#define TRC_RD       (5)  // ba, addr : column
+#define TRC_BST      (6)  // ba
+// Data bursts
+#define TRC_WR_BURST (8)  // ba, addr : column, data : byte address
+#define TRC_RD_BURST (9)  // ba, addr : column, data : byte address
+#define TRC_WR_DATA  (10) // ba, addr : column, dqm, data
+#define TRC_RD_DATA  (11) // ba, addr : column, dqm, data
+#define TRC_WR_END   (12) // ba, addr : 1 for auto-precharge
+#define TRC_RD_END   (13) // ba, addr : 1 for auto-precharge
+
+// Trace file header
+typedef struct
+{
+    char     magic[8];  // "SDRTRC01"
+    uint32_t bus_log2;  // Data bus width (log2(bytes))
+    uint32_t bit_rows;  // Number of rows (log 2)
+    uint32_t bit_cols;  // Number of columns (log 2)
+    uint32_t flags;     // SDRAM flags
+} sdram_trace_hdr;
+
+// Trace record (24 bytes)
+typedef struct
+{
+    uint64_t ts;        // Time stamp (ps)
+    uint64_t data;      // Data bus or byte address
+    uint16_t addr;      // Address bus
+    uint8_t  type;      // Record type (TRC_xxx)
+    uint8_t  ba;        // Bank address
+    uint8_t  dqm;       // Data mask
+    uint8_t  pad[3];
+} sdram_trace_rec;
+
+#endif /* _SDR_TRACE_H_ */
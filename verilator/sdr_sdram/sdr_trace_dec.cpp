@@ -0,0 +1,262 @@
+// Copyright 2013 Frederic Requin
+//
+// This file is part of the MCC216 project (www.arcaderetrogaming.com)
+//
+// The SDRAM C++ model is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// The SDRAM C++ model is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// SDRAM binary trace decoder:
+// ---------------------------
+//  - Pretty-prints a binary trace written by the SDRAM C++ model
+//  - Same text format as the former SDRAM log file
+//  - Usage : sdr_trace_dec <trace file> [<text file>]
+//  - Build : g++ -O2 -o sdr_trace_dec sdr_trace_dec.cpp
+//
+
+#include "sdr_trace.h"
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+#define DEC_BUF_SIZE (65536)
+
+// Commands logged during a burst, printed at the end of the burst
+static std::string pend_buf;
+
+static void pend_printf(const char *str)
+{
+    pend_buf += str;
+}
+
+static void pend_flush(FILE *fh)
+{
+    if (!pend_buf.empty())
+    {
+        fwrite(pend_buf.data(), pend_buf.size(), 1, fh);
+        pend_buf.clear();
+    }
+}
+
+// Mode register decoding (a continuous burst is one page long)
+static void decode_lmr(uint16_t addr, int page_len)
+{
+    int bst_len_rd;
+
+    // CAS latency
+    switch ((addr >> 4) & 7)
+    {
+        case 2  : pend_printf("CAS latency        = 2 cycles\n"); break;
+        case 3  : pend_printf("CAS latency        = 3 cycles\n"); break;
+        default : pend_printf("CAS latency        = ???\n");
+    }
+
+    // Burst length
+    switch (addr & 7)
+    {
+        case 0  : pend_printf("Read burst length  = 1 word\n");     bst_len_rd = 1;        break;
+        case 1  : pend_printf("Read burst length  = 2 words\n");    bst_len_rd = 2;        break;
+        case 2  : pend_printf("Read burst length  = 4 words\n");    bst_len_rd = 4;        break;
+        case 3  : pend_printf("Read burst length  = 8 words\n");    bst_len_rd = 8;        break;
+        case 7  : pend_printf("Read burst length  = continuous\n"); bst_len_rd = page_len; break;
+        default : pend_printf("Read burst length  = ???\n");        bst_len_rd = 0;
+    }
+
+    // Burst type
+    if (addr & 8)
+        pend_printf("Burst type         = interleaved (NOT SUPPORTED !)\n");
+    else
+        pend_printf("Burst type         = sequential\n");
+
+    // Write burst
+    if (addr & 0x200)
+    {
+        pend_printf("Write burst length = 1\n");
+    }
+    else if (bst_len_rd)
+    {
+        char str[64];
+
+        if (bst_len_rd <= 8)
+            sprintf(str, "Write burst length = %d word(s)\n", bst_len_rd);
+        else
+            sprintf(str, "Write burst length = continuous\n");
+        pend_printf(str);
+    }
+    else
+    {
+        pend_printf("Write burst length = ???\n");
+    }
+}
+
+int main(int argc, char **argv)
+{
+    FILE            *fh_in;
+    FILE            *fh_out;
+    sdram_trace_hdr  hdr;
+    sdram_trace_rec *buf;
+    size_t           cnt;
+    unsigned long    total;
+    int              bus_mask;
+    bool             bst_act;  // Burst being printed
+    uint64_t         prev_ts;
+    char             str[256];
+
+    if ((argc < 2) || (argc > 3))
+    {
+        printf("Usage : %s <trace file> [<text file>]\n", argv[0]);
+        return 1;
+    }
+
+    fh_in = fopen(argv[1], "rb");
+    if (!fh_in)
+    {
+        printf("Cannot open trace file \"%s\" !!\n", argv[1]);
+        return 1;
+    }
+    if ((fread((void *)&hdr, sizeof(hdr), 1, fh_in) != 1) || (memcmp(hdr.magic, TRC_MAGIC, 8)))
+    {
+        printf("\"%s\" is not an SDRAM trace file !!\n", argv[1]);
+        fclose(fh_in);
+        return 1;
+    }
+
+    fh_out = (argc == 3) ? fopen(argv[2], "w") : stdout;
+    if (!fh_out)
+    {
+        printf("Cannot create text file \"%s\" !!\n", argv[2]);
+        fclose(fh_in);
+        return 1;
+    }
+
+    bus_mask = (1 << hdr.bus_log2) - 1;
+    bst_act  = false;
+    prev_ts  = 0;
+    total    = 0;
+    buf      = new sdram_trace_rec[DEC_BUF_SIZE];
+
+    while ((cnt = fread((void *)buf, sizeof(sdram_trace_rec), DEC_BUF_SIZE, fh_in)) > 0)
+    {
+        for (size_t i = 0; i < cnt; i++)
+        {
+            sdram_trace_rec *rec = buf + i;
+
+            // New cycle : commands are printed right away outside of a burst
+            if ((rec->ts != prev_ts) && (!bst_act)) pend_flush(fh_out);
+            prev_ts = rec->ts;
+
+            switch (rec->type)
+            {
+                case TRC_LMR:
+                {
+                    sprintf(str, "Load Std Mode Register @ %llu ps\n", (unsigned long long)rec->ts);
+                    pend_printf(str);
+                    decode_lmr(rec->addr, 1 << hdr.bit_cols);
+                    break;
+                }
+                case TRC_REF:
+                {
+                    sprintf(str, "Auto Refresh @ %llu ps\n", (unsigned long long)rec->ts);
+                    pend_printf(str);
+                    break;
+                }
+                case TRC_PRE:
+                {
+                    if (rec->addr)
+                        sprintf(str, "Precharge all banks @ %llu ps\n", (unsigned long long)rec->ts);
+                    else
+                        sprintf(str, "Precharge bank #%d @ %llu ps\n", rec->ba, (unsigned long long)rec->ts);
+                    pend_printf(str);
+                    break;
+                }
+                case TRC_ACT:
+                {
+                    sprintf(str, "Activate bank #%d, row #%d @ %llu ps\n", rec->ba, rec->addr, (unsigned long long)rec->ts);
+                    pend_printf(str);
+                    break;
+                }
+                case TRC_WR:
+                {
+                    sprintf(str, "Write bank #%d, col #%d @ %llu ps\n", rec->ba, rec->addr, (unsigned long long)rec->ts);
+                    pend_printf(str);
+                    break;
+                }
+                case TRC_RD:
+                {
+                    sprintf(str, "Read bank #%d, col #%d @ %llu ps\n", rec->ba, rec->addr, (unsigned long long)rec->ts);
+                    pend_printf(str);
+                    break;
+                }
+                case TRC_BST:
+                {
+                    sprintf(str, "Burst Stop bank #%d @ %llu ps\n", rec->ba, (unsigned long long)rec->ts);
+                    pend_printf(str);
+                    break;
+                }
+                case TRC_RD_BURST:
+                {
+                    // A read burst interrupts the current burst
+                    if (bst_act) fprintf(fh_out, "\n");
+                    pend_flush(fh_out);
+                }
+                // Fall through
+                case TRC_WR_BURST:
+                {
+                    fprintf(fh_out, "%08X : ", (unsigned)rec->data);
+                    bst_act = true;
+                    break;
+                }
+                case TRC_WR_DATA:
+                case TRC_RD_DATA:
+                {
+                    // MSB first, masked bytes as "XX"
+                    for (int k = bus_mask; k >= 0; k--)
+                    {
+                        if (rec->dqm & (1 << k))
+                            fprintf(fh_out, "XX");
+                        else
+                            fprintf(fh_out, "%02X", (unsigned)(rec->data >> (k << 3)) & 0xFF);
+                    }
+                    fprintf(fh_out, " ");
+                    break;
+                }
+                case TRC_WR_END:
+                case TRC_RD_END:
+                {
+                    if (rec->addr)
+                        fprintf(fh_out, (rec->type == TRC_WR_END) ? "PRE\n\n" : "PRE\n");
+                    else
+                        fprintf(fh_out, "\n");
+                    pend_flush(fh_out);
+                    bst_act = false;
+                    break;
+                }
+                default:
+                {
+                    fprintf(fh_out, "Unknown record type %d @ %llu ps\n", rec->type, (unsigned long long)rec->ts);
+                }
+            }
+        }
+        total += (unsigned long)cnt;
+    }
+    pend_flush(fh_out);
+
+    delete[] buf;
+    fclose(fh_in);
+    if (fh_out != stdout)
+    {
+        fclose(fh_out);
+        printf("%lu records decoded\n", total);
+    }
+
+    return 0;
+}
@@ -0,0 +1,183 @@
+// Copyright 2008-2019 Frederic Requin
+//
+// This file is part of the 1943 FPGA core
+//
+// The 1943 FPGA core is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// The 1943 FPGA core is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "verilated.h"
+#include "sim_perf.h"
+#include <stdio.h>
+#include <string.h>
+#include <sys/resource.h>
+
+// Sections names (report)
+static const char *sect_name[PERF_NUM] = { "eval", "sdram", "video", "trace" };
+
+// Constructor
+SimPerf::SimPerf(bool split, vluint64_t sim_ps)
+{
+    sect_on    = split;
+    restart(sim_ps);
+}
+
+// Destructor
+SimPerf::~SimPerf()
+{
+}
+
+// Clear the counters (the run is measured from now on)
+void SimPerf::restart(vluint64_t sim_ps)
+{
+    sect_beg   = (vluint64_t)0;
+    for (int i = 0; i < PERF_NUM; i++)
+    {
+        sect_ns[i] = (vluint64_t)0;
+    }
+    num_steps  = (vluint64_t)0;
+    num_edges  = (vluint64_t)0;
+    num_bus    = (vluint64_t)0;
+    num_vid    = (vluint64_t)0;
+    num_evals  = (vluint64_t)0;
+    start_ns   = now_ns();
+    start_ps   = sim_ps;
+    frame_ns   = start_ns;
+    frame_ps   = sim_ps;
+    num_frames = 0;
+}
+
+// Monotonic wall clock (in ns)
+vluint64_t SimPerf::now_ns()
+{
+    struct timespec ts;
+    
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    
+    return (vluint64_t)ts.tv_sec * (vluint64_t)1000000000 + (vluint64_t)ts.tv_nsec;
+}
+
+// End of frame : frames counter, optional progress line
+void SimPerf::frame(int frame_nr, vluint64_t sim_ps, bool print)
+{
+    vluint64_t curr_ns = now_ns();
+    double     wall_s  = (double)(curr_ns - frame_ns) * 1e-9;
+    double     sim_us  = (double)(sim_ps - frame_ps) * 1e-6;
+    
+    if ((print) && (wall_s > 0.0))
+    {
+        printf(" Frame #%d : %.1f us simulated in %.3f s (%.1f us/s, %.3f fps)\n",
+               frame_nr, sim_us, wall_s, sim_us / wall_s, 1.0 / wall_s);
+    }
+    frame_ns = curr_ns;
+    frame_ps = sim_ps;
+    num_frames++;
+}
+
+// End of run : summary, saved in JSON (".json" file) or CSV format
+void SimPerf::report(const char *name, vluint64_t sim_ps)
+{
+    double     wall_s  = (double)(now_ns() - start_ns) * 1e-9;
+    double     sim_us  = (double)(sim_ps - start_ps) * 1e-6;
+    double     sect_s[PERF_NUM];
+    double     other_s = wall_s;
+    double     rate    = (wall_s > 0.0) ? 1.0 / wall_s : 0.0;
+    long       rss_kb;
+    struct rusage ru;
+    FILE      *fh;
+    
+    // Peak resident set size (in KB)
+    getrusage(RUSAGE_SELF, &ru);
+    rss_kb = ru.ru_maxrss;
+    
+    for (int i = 0; i < PERF_NUM; i++)
+    {
+        sect_s[i] = (double)sect_ns[i] * 1e-9;
+        other_s  -= sect_s[i];
+    }
+    if (!sect_on) other_s = 0.0;
+    
+    printf("\nSimulation performance :\n");
+    printf(" Wall time       : %.3f s\n", wall_s);
+    printf(" Simulated time  : %.1f us (%.1f us/s)\n", sim_us, sim_us * rate);
+    printf(" Frames          : %d (%.3f fps)\n", num_frames, (double)num_frames * rate);
+    printf(" Clock edges     : %llu (%.0f edges/s)\n", num_edges, (double)num_edges * rate);
+    printf(" Evaluations     : %llu (%.0f evals/s)\n", num_evals, (double)num_evals * rate);
+    printf(" Bus clock       : %llu cycles (%.1f kHz)\n", num_bus, (double)num_bus * rate * 1e-3);
+    printf(" Video clock     : %llu cycles (%.1f kHz)\n", num_vid, (double)num_vid * rate * 1e-3);
+    printf(" Peak RSS        : %ld KB\n", rss_kb);
+    if (sect_on)
+    {
+        for (int i = 0; i < PERF_NUM; i++)
+        {
+            printf(" %-5s           : %.3f s (%.1f %%)\n", sect_name[i], sect_s[i], sect_s[i] * rate * 100.0);
+        }
+        printf(" other           : %.3f s (%.1f %%)\n", other_s, other_s * rate * 100.0);
+    }
+    
+    if ((!name) || (!name[0])) return;
+    
+    fh = fopen(name, "w");
+    if (!fh)
+    {
+        printf("Cannot create performance report file \"%s\" !!\n", name);
+        return;
+    }
+    
+    if ((strlen(name) > 5) && (!strcmp(name + strlen(name) - 5, ".json")))
+    {
+        fprintf(fh, "{\n");
+        fprintf(fh, "  \"wall_s\": %.6f,\n", wall_s);
+        fprintf(fh, "  \"sim_us\": %.3f,\n", sim_us);
+        fprintf(fh, "  \"sim_us_per_s\": %.3f,\n", sim_us * rate);
+        fprintf(fh, "  \"frames\": %d,\n", num_frames);
+        fprintf(fh, "  \"fps\": %.6f,\n", (double)num_frames * rate);
+        fprintf(fh, "  \"steps\": %llu,\n", num_steps);
+        fprintf(fh, "  \"edges\": %llu,\n", num_edges);
+        fprintf(fh, "  \"edges_per_s\": %.1f,\n", (double)num_edges * rate);
+        fprintf(fh, "  \"evals\": %llu,\n", num_evals);
+        fprintf(fh, "  \"evals_per_s\": %.1f,\n", (double)num_evals * rate);
+        fprintf(fh, "  \"bus_cycles\": %llu,\n", num_bus);
+        fprintf(fh, "  \"bus_khz\": %.3f,\n", (double)num_bus * rate * 1e-3);
+        fprintf(fh, "  \"vid_cycles\": %llu,\n", num_vid);
+        fprintf(fh, "  \"vid_khz\": %.3f,\n", (double)num_vid * rate * 1e-3);
+        fprintf(fh, "  \"max_rss_kb\": %ld,\n", rss_kb);
+        fprintf(fh, "  \"split\": %s", (sect_on) ? "true" : "false");
+        if (sect_on)
+        {
+            for (int i = 0; i < PERF_NUM; i++)
+            {
+                fprintf(fh, ",\n  \"%s_s\": %.6f", sect_name[i], sect_s[i]);
+            }
+            fprintf(fh, ",\n  \"other_s\": %.6f", other_s);
+        }
+        fprintf(fh, "\n}\n");
+    }
+    else
+    {
+        // Same columns with or without the split timing
+        fprintf(fh, "wall_s,sim_us,sim_us_per_s,frames,fps,steps,edges,edges_per_s,evals,evals_per_s,"
+                    "bus_cycles,bus_khz,vid_cycles,vid_khz,max_rss_kb,eval_s,sdram_s,video_s,trace_s,other_s\n");
+        fprintf(fh, "%.6f,%.3f,%.3f,%d,%.6f,%llu,%llu,%.1f,%llu,%.1f,%llu,%.3f,%llu,%.3f,%ld",
+                wall_s, sim_us, sim_us * rate, num_frames, (double)num_frames * rate,
+                num_steps, num_edges, (double)num_edges * rate, num_evals, (double)num_evals * rate,
+                num_bus, (double)num_bus * rate * 1e-3, num_vid, (double)num_vid * rate * 1e-3, rss_kb);
+        for (int i = 0; i < PERF_NUM; i++)
+        {
+            fprintf(fh, ",%.6f", sect_s[i]);
+        }
+        fprintf(fh, ",%.6f\n", other_s);
+    }
+    fclose(fh);
+    
+    printf("Performance report saved in file \"%s\"\n", name);
+}
@@ -0,0 +1,89 @@
+// Copyright 2008-2019 Frederic Requin
+//
+// This file is part of the 1943 FPGA core
+//
+// The 1943 FPGA core is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// The 1943 FPGA core is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Simulation performance counters:
+// --------------------------------
+//  - Monotonic nanosecond clock, optional split of the wall time between the models
+//  - Clock edges, evaluations, bus/video cycles and frames counters
+//  - Per-frame progress line and end-of-run report (JSON or CSV), with the peak RSS
+//  - Counters can be restarted (warm-up frames not measured)
+//  - The split timing costs two clock reads per timed section
+//
+
+#ifndef _SIM_PERF_H_
+#define _SIM_PERF_H_
+
+#include "verilated.h"
+#include <time.h>
+
+// Timed sections
+#define PERF_EVAL    (0)  // Verilated model
+#define PERF_SDRAM   (1)  // SDRAM C++ model
+#define PERF_VIDEO   (2)  // Video output C++ model
+#define PERF_TRACE   (3)  // VCD tracing
+#define PERF_NUM     (4)
+
+class SimPerf
+{
+    public:
+        // Constructor and destructor
+        SimPerf(bool split, vluint64_t sim_ps);
+        ~SimPerf();
+        // Methods
+        static vluint64_t now_ns();
+        inline void begin()
+        {
+            if (sect_on) sect_beg = now_ns();
+        }
+        inline void end(int sect)
+        {
+            if (sect_on) sect_ns[sect] += now_ns() - sect_beg;
+        }
+        inline void step(vluint32_t edges, vluint32_t rises)
+        {
+            num_steps++;
+            num_edges += (vluint64_t)__builtin_popcount(edges);
+            num_bus   += (vluint64_t)(rises & 1);
+            num_vid   += (vluint64_t)((rises >> 1) & 1);
+        }
+        inline void eval()
+        {
+            num_evals++;
+        }
+        void       frame(int frame_nr, vluint64_t sim_ps, bool print);
+        void       restart(vluint64_t sim_ps);
+        void       report(const char *name, vluint64_t sim_ps);
+    private:
+        // Split timing
+        bool       sect_on;
+        vluint64_t sect_beg;
+        vluint64_t sect_ns[PERF_NUM];
+        // Counters
+        vluint64_t num_steps;                  // Time steps (ClockGen::AdvanceClocks calls)
+        vluint64_t num_edges;                  // Clock edges
+        vluint64_t num_bus;                    // Bus clock cycles (rising edges of clock #0)
+        vluint64_t num_vid;                    // Video clock cycles (rising edges of clock #1)
+        vluint64_t num_evals;                  // Verilated model evaluations
+        // Wall time
+        vluint64_t start_ns;
+        vluint64_t start_ps;                   // Simulated time at the beginning of the run
+        vluint64_t frame_ns;                   // Previous frame
+        vluint64_t frame_ps;
+        int        num_frames;
+};
+
+#endif /* _SIM_PERF_H_ */
@@ -17,6 +17,8 @@
 
 // Trace configuration
 // -------------------
+// Every module is traced but the memory blocks, the scopes actually dumped
+// are selected at run time (+trace_scope)
 `verilator_config
 
 tracing_off -file "mem_dc_1024x9to9r.v"
@@ -26,25 +28,8 @@ tracing_off -file "mem_dc_4096x8to32r.v"
 tracing_off -file "mem_dc_4096x8to8r.v"
 tracing_off -file "mem_dc_512x32to8r.v"
 
-tracing_on -file "sdram_ctrl.v"
-
-tracing_off -file "gpu_gpios.v"
-tracing_on -file "gpu_vbeam.v"
-tracing_on -file "gpu_dmaseq.v"
-tracing_off -file "gpu_charmap.v"
-tracing_off -file "gpu_tilemap.v"
-tracing_on -file "gpu_sprites.v"
-tracing_on -file "gpu_colormux.v"
-tracing_on -file "gpu_scandoubler.v"
-tracing_on -file "gpu_top.v"
-
-tracing_off -file "tv80_alu.v"
-tracing_off -file "tv80_core.v"
-tracing_off -file "tv80_mcode.v"
-tracing_off -file "tv80_reg.v"
-tracing_off -file "tv80se.v"
-
-tracing_on -file "top_1943.v"
+// GPU config (Scale2X, scanlines) forced by the native resolution capture
+public_flat_rw -module "gpu_gpios" -var "r_cfg_reg"
 
 `verilog
 // Memory blocks
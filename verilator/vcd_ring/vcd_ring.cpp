@@ -0,0 +1,89 @@
+// Copyright 2008-2019 Frederic Requin
+//
+// This file is part of the 1943 FPGA core
+//
+// The 1943 FPGA core is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// The 1943 FPGA core is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#if VM_TRACE && !VM_TRACE_FST
+
+#include "vcd_ring.h"
+#include <stdio.h>
+
+// Constructor
+VcdRing::VcdRing(int frames)
+{
+    num_slots = (frames > 0) ? frames : 1;
+    num_used  = 0;
+    slot_cur  = -1;
+    slot_name.resize(num_slots);
+    slot_data.resize(num_slots);
+    
+    printf("VCD flight recorder : last %d frames kept in memory\n", num_slots);
+}
+
+// Destructor
+VcdRing::~VcdRing()
+{
+}
+
+// New VCD file : recycle the oldest frame
+bool VcdRing::open(const std::string &name)
+{
+    slot_cur = (slot_cur + 1) % num_slots;
+    slot_name[slot_cur] = name;
+    slot_data[slot_cur].clear();
+    if (num_used < num_slots) num_used++;
+    
+    return true;
+}
+
+// End of a VCD file : it stays in the ring
+void VcdRing::close()
+{
+}
+
+// VCD data
+ssize_t VcdRing::write(const char *bufp, ssize_t len)
+{
+    if (slot_cur >= 0) slot_data[slot_cur].append(bufp, (size_t)len);
+    
+    return len;
+}
+
+// Write the frames to disk, the oldest first. Only the frame being traced
+// stays in the ring (written again with more data by the next dump)
+void VcdRing::dump(const char *reason)
+{
+    printf(" VCD flight recorder (%s) : %d frames dumped\n", reason, num_used);
+    
+    for (int i = num_used - 1; i >= 0; i--)
+    {
+        int   idx = (slot_cur - i + num_slots) % num_slots;
+        FILE *fh  = fopen(slot_name[idx].c_str(), "wb");
+        
+        if (fh)
+        {
+            fwrite(slot_data[idx].data(), 1, slot_data[idx].size(), fh);
+            fclose(fh);
+        }
+        else
+        {
+            printf("Cannot create VCD file \"%s\" !!\n", slot_name[idx].c_str());
+        }
+        if (i) slot_data[idx].clear();
+    }
+    if (num_used) num_used = 1;
+}
+
+#endif /* VM_TRACE && !VM_TRACE_FST */
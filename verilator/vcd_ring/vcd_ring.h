@@ -0,0 +1,59 @@
+// Copyright 2008-2019 Frederic Requin
+//
+// This file is part of the 1943 FPGA core
+//
+// The 1943 FPGA core is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// The 1943 FPGA core is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// VCD flight recorder:
+// --------------------
+//  - Replaces the VCD file of "VerilatedVcdC" by a ring of memory buffers
+//  - One buffer per VCD file (the testbench opens a new file every frame)
+//  - Only the last frames are kept, they are written to disk on request
+//    (trigger or end of simulation)
+//  - VCD traces only (not built with FST tracing)
+//
+
+#ifndef _VCD_RING_H_
+#define _VCD_RING_H_
+
+#if VM_TRACE && !VM_TRACE_FST
+
+#include "verilated.h"
+#include "verilated_vcd_c.h"
+#include <string>
+#include <vector>
+
+class VcdRing : public VerilatedVcdFile
+{
+    public:
+        // Constructor and destructor
+        VcdRing(int frames);
+        virtual ~VcdRing();
+        // VerilatedVcdFile methods
+        virtual bool    open(const std::string &name);
+        virtual void    close();
+        virtual ssize_t write(const char *bufp, ssize_t len);
+        // Methods
+        void            dump(const char *reason);
+    private:
+        int        num_slots;                  // Number of frames kept
+        int        num_used;                   // Frames in the ring
+        int        slot_cur;                   // Frame being traced (-1 : none)
+        std::vector<std::string> slot_name;    // VCD file names
+        std::vector<std::string> slot_data;    // VCD contents
+};
+
+#endif /* VM_TRACE && !VM_TRACE_FST */
+
+#endif /* _VCD_RING_H_ */
@@ -32,6 +32,7 @@
 #include "../easy_bmp/EasyBMP.h"
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <time.h>
 
 // Constructor
@@ -62,6 +63,36 @@ VideoOut::VideoOut(vluint8_t debug, vluint8_t depth, vluint8_t polarity, vluint1
     bmp         = new BMP;
     bmp->SetBitDepth(24);
     bmp->SetSize((int)hactive, (int)vactive);
+    // allocate the frame buffers
+    fb_width    = (int)hactive;
+    fb_height   = (int)vactive;
+    for (int i = 0; i < VIDEO_RING_SIZE; i++)
+    {
+        fb_ring[i] = new vluint8_t[(int)hactive * (int)vactive * 3];
+        memset((void *)fb_ring[i], 0, (int)hactive * (int)vactive * 3);
+        name_ring[i][0] = 0;
+    }
+    fb          = fb_ring[0];
+    // full resolution capture
+    nat_on      = false;
+    nat_check   = false;
+    nat_xpos    = (int *)NULL;
+    nat_ypos    = (int *)NULL;
+    nat_xrep    = (bool *)NULL;
+    nat_yrep    = (bool *)NULL;
+    nat_err     = (int)0;
+    // no writer thread
+    wr_async    = false;
+    wr_exit     = false;
+    ring_wr     = (int)0;
+    ring_rd     = (int)0;
+    ring_cnt    = (int)0;
+    // no frame hashing
+    hash_on     = false;
+    fh_hash     = (FILE *)NULL;
+    hash_err    = (int)-1;
+    // frames captured
+    cap_on      = true;
     // copy the filename
     strncpy(filename, file, 255);
     // internal variables cleared
@@ -97,7 +128,21 @@ VideoOut::VideoOut(vluint8_t debug, vluint8_t depth, vluint8_t polarity, vluint1
 // Destructor
 VideoOut::~VideoOut()
 {
+    // flush the pending frames
+    set_async(false);
+    if (fh_hash) fclose(fh_hash);
+    if (nat_on)
+    {
+        delete [] nat_xpos;
+        delete [] nat_ypos;
+        delete [] nat_xrep;
+        delete [] nat_yrep;
+    }
     delete    bmp;
+    for (int i = 0; i < VIDEO_RING_SIZE; i++)
+    {
+        delete [] fb_ring[i];
+    }
     for (int i = 0; i < 8; i++)
     {
         delete [] y_buf[i];
@@ -106,6 +151,51 @@ VideoOut::~VideoOut()
     }
 }
 
+// Store a pixel in the frame buffer
+inline void VideoOut::put_pixel(int x, int y, RGBApixel pixel)
+{
+    vluint8_t *p;
+    
+    if (nat_on)
+    {
+        put_native(x, y, pixel);
+        return;
+    }
+    
+    p = fb + (y * fb_width + x) * 3;
+    p[0] = pixel.Red;
+    p[1] = pixel.Green;
+    p[2] = pixel.Blue;
+}
+
+// Store a pixel in the native resolution frame buffer
+void VideoOut::put_native(int x, int y, RGBApixel pixel)
+{
+    int        nx = nat_xpos[x];
+    int        ny = nat_ypos[y];
+    vluint8_t *p;
+    
+    // cropped
+    if ((nx < 0) || (ny < 0)) return;
+    
+    p = fb + (ny * fb_width + nx) * 3;
+    if ((nat_xrep[x]) || (nat_yrep[y]))
+    {
+        // replicated pixel : the first one of the block is already stored
+        if ((nat_check) && ((p[0] != pixel.Red) || (p[1] != pixel.Green) || (p[2] != pixel.Blue)))
+        {
+            if ((dbg_on) && (!nat_err)) printf(" Replicated pixel (%d, %d) differs\n", x, y);
+            nat_err++;
+        }
+    }
+    else
+    {
+        p[0] = pixel.Red;
+        p[1] = pixel.Green;
+        p[2] = pixel.Blue;
+    }
+}
+
 // Cycle evaluate : RGB444 with synchros
 vluint8_t VideoOut::eval_RGB444_HV
 (
@@ -137,7 +227,7 @@ vluint8_t VideoOut::eval_RGB444_HV
                 pixel.Green = (green & bit_mask) << bit_shift;
                 pixel.Blue  = (blue  & bit_mask) << bit_shift;
                 
-                bmp->SetPixel((int)(hcount - hor_offs), (int)(vcount - ver_offs), pixel);
+                put_pixel((int)(hcount - hor_offs), (int)(vcount - ver_offs), pixel);
             }
         }
         
@@ -149,15 +239,7 @@ vluint8_t VideoOut::eval_RGB444_HV
             hcount = (vluint16_t)0;
             vcount = (vluint16_t)0;
             
-            if (dump_act)
-            {
-                char tmp[264];
-                
-                sprintf(tmp, "%s_%04d.bmp", filename, dump_ctr);
-                printf(" Save snapshot in file \"%s\"\n", tmp);
-                bmp->WriteToFile(tmp);
-                dump_ctr++;
-            }
+            if (dump_act) save_frame();
             if (filename[0]) dump_act = 1;
         }
         
@@ -200,46 +282,57 @@ vluint8_t VideoOut::eval_RGB444_DE
     // Rising edge on clock
     if (clk && !prev_clk)
     {
-        // Grab active area
-        if (de)
-        {
-            RGBApixel pixel;
-                
-            pixel.Red   = (red   & bit_mask) << bit_shift;
-            pixel.Green = (green & bit_mask) << bit_shift;
-            pixel.Blue  = (blue  & bit_mask) << bit_shift;
+        ret = eval_RGB444_DE_posedge(cycle, de, red, green, blue);
+    }
+    prev_clk = clk;
+    
+    return ret;
+}
+
+// Cycle evaluate : RGB444 with data enable, on a clock rising edge (edge detected by the caller)
+vluint8_t VideoOut::eval_RGB444_DE_posedge
+(
+    vluint64_t cycle,
+    // Data enable
+    vluint8_t  de,
+    // RGB colors
+    vluint8_t  red,
+    vluint8_t  green,
+    vluint8_t  blue
+)
+{
+    vluint8_t ret = (vluint8_t)0;
+    
+    // Grab active area
+    if (de)
+    {
+        RGBApixel pixel;
             
-            bmp->SetPixel((int)hcount, (int)vcount, pixel);
+        pixel.Red   = (red   & bit_mask) << bit_shift;
+        pixel.Green = (green & bit_mask) << bit_shift;
+        pixel.Blue  = (blue  & bit_mask) << bit_shift;
+        
+        put_pixel((int)hcount, (int)vcount, pixel);
+        
+        hcount++;
+        if (hcount == hor_size)
+        {
+            if (dbg_on) printf(" Rising edge on HS @ cycle #%llu (vcount = %d)\n", cycle, vcount);
+            hcount = (vluint16_t)0;
             
-            hcount++;
-            if (hcount == hor_size)
+            vcount++;
+            if (vcount == ver_size)
             {
-                if (dbg_on) printf(" Rising edge on HS @ cycle #%llu (vcount = %d)\n", cycle, vcount);
-                hcount = (vluint16_t)0;
+                if (filename[0]) dump_act = 1;
                 
-                vcount++;
-                if (vcount == ver_size)
-                {
-                    if (filename[0]) dump_act = 1;
-                    
-                    ret = dump_act;
-                    if (dbg_on) printf(" Rising edge on VS @ cycle #%llu\n", cycle);
-                    vcount = (vluint16_t)0;
-                    
-                    if (dump_act)
-                    {
-                        char tmp[264];
-                        
-                        sprintf(tmp, "%s_%04d.bmp", filename, dump_ctr);
-                        printf(" Save snapshot in file \"%s\"\n", tmp);
-                        bmp->WriteToFile(tmp);
-                        dump_ctr++;
-                    }
-                }
+                ret = dump_act;
+                if (dbg_on) printf(" Rising edge on VS @ cycle #%llu\n", cycle);
+                vcount = (vluint16_t)0;
+                
+                if (dump_act) save_frame();
             }
         }
     }
-    prev_clk = clk;
     
     return ret;
 }
@@ -275,7 +368,7 @@ vluint8_t VideoOut::eval_YUV444_HV
                 u = (int)cb;
                 v = (int)cr;
                 
-                bmp->SetPixel((int)(hcount - hor_offs), (int)(vcount - ver_offs), yuv2rgb(y,u,v));
+                put_pixel((int)(hcount - hor_offs), (int)(vcount - ver_offs), yuv2rgb(y,u,v));
             }
         }
         
@@ -287,15 +380,7 @@ vluint8_t VideoOut::eval_YUV444_HV
             hcount = (vluint16_t)0;
             vcount = (vluint16_t)0;
             
-            if (dump_act)
-            {
-                char tmp[264];
-                
-                sprintf(tmp, "%s_%04d.bmp", filename, dump_ctr);
-                printf(" Save snapshot in file \"%s\"\n", tmp);
-                bmp->WriteToFile(tmp);
-                dump_ctr++;
-            }
+            if (dump_act) save_frame();
             if (filename[0]) dump_act = 1;
         }
         
@@ -347,7 +432,7 @@ vluint8_t VideoOut::eval_YUV444_DE
             u = (int)cb;
             v = (int)cr;
                 
-            bmp->SetPixel((int)hcount, (int)vcount, yuv2rgb(y,u,v));
+            put_pixel((int)hcount, (int)vcount, yuv2rgb(y,u,v));
             
             hcount++;
             if (hcount == hor_size)
@@ -364,15 +449,7 @@ vluint8_t VideoOut::eval_YUV444_DE
                     if (dbg_on) printf(" Rising edge on VS @ cycle #%llu\n", cycle);
                     vcount = (vluint16_t)0;
                     
-                    if (dump_act)
-                    {
-                        char tmp[264];
-                        
-                        sprintf(tmp, "%s_%04d.bmp", filename, dump_ctr);
-                        printf(" Save snapshot in file \"%s\"\n", tmp);
-                        bmp->WriteToFile(tmp);
-                        dump_ctr++;
-                    }
+                    if (dump_act) save_frame();
                 }
             }
         }
@@ -414,9 +491,9 @@ vluint8_t VideoOut::eval_YUV422_HV
                     y = (int)luma;
                     v = (int)chroma;
                     
-                    bmp->SetPixel((int)(hcount - hor_offs - 1), (int)(vcount - ver_offs), yuv2rgb(y0,u0,v));
+                    put_pixel((int)(hcount - hor_offs - 1), (int)(vcount - ver_offs), yuv2rgb(y0,u0,v));
                     
-                    bmp->SetPixel((int)(hcount - hor_offs), (int)(vcount - ver_offs), yuv2rgb(y,u0,v));
+                    put_pixel((int)(hcount - hor_offs), (int)(vcount - ver_offs), yuv2rgb(y,u0,v));
                 }
                 else
                 {
@@ -435,15 +512,7 @@ vluint8_t VideoOut::eval_YUV422_HV
             hcount = (vluint16_t)0;
             vcount = (vluint16_t)0;
             
-            if (dump_act)
-            {
-                char tmp[264];
-                
-                sprintf(tmp, "%s_%04d.bmp", filename, dump_ctr);
-                printf(" Save snapshot in file \"%s\"\n", tmp);
-                bmp->WriteToFile(tmp);
-                dump_ctr++;
-            }
+            if (dump_act) save_frame();
             if (filename[0]) dump_act = 1;
         }
         
@@ -496,9 +565,9 @@ vluint8_t VideoOut::eval_YUV422_DE
                 y = (int)luma;
                 v = (int)chroma;
                 
-                bmp->SetPixel((int)(hcount - 1), (int)vcount, yuv2rgb(y0,u0,v));
+                put_pixel((int)(hcount - 1), (int)vcount, yuv2rgb(y0,u0,v));
                 
-                bmp->SetPixel((int)hcount, (int)vcount, yuv2rgb(y,u0,v));
+                put_pixel((int)hcount, (int)vcount, yuv2rgb(y,u0,v));
             }
             else
             {
@@ -522,15 +591,7 @@ vluint8_t VideoOut::eval_YUV422_DE
                     if (dbg_on) printf(" Rising edge on VS @ cycle #%llu\n", cycle);
                     vcount = (vluint16_t)0;
                     
-                    if (dump_act)
-                    {
-                        char tmp[264];
-                        
-                        sprintf(tmp, "%s_%04d.bmp", filename, dump_ctr);
-                        printf(" Save snapshot in file \"%s\"\n", tmp);
-                        bmp->WriteToFile(tmp);
-                        dump_ctr++;
-                    }
+                    if (dump_act) save_frame();
                 }
             }
         }
@@ -593,16 +654,16 @@ vluint8_t VideoOut::eval_YUV420_DE
                 v = c_buf[(vcount2 & 1) ^ 1][i+1];
                 
                 y = y_buf[(vcount1 & 2) ^ 2][i];
-                bmp->SetPixel(i,   (int)vcount,   yuv2rgb(y,u,v));
+                put_pixel(i,   (int)vcount,   yuv2rgb(y,u,v));
                 
                 y = y_buf[(vcount1 & 2) ^ 2][i+1];
-                bmp->SetPixel(i+1, (int)vcount,   yuv2rgb(y,u,v));
+                put_pixel(i+1, (int)vcount,   yuv2rgb(y,u,v));
                 
                 y = y_buf[(vcount1 & 2) ^ 3][i];
-                bmp->SetPixel(i,   (int)vcount+1, yuv2rgb(y,u,v));
+                put_pixel(i,   (int)vcount+1, yuv2rgb(y,u,v));
                 
                 y = y_buf[(vcount1 & 2) ^ 3][i+1];
-                bmp->SetPixel(i+1, (int)vcount+1, yuv2rgb(y,u,v));
+                put_pixel(i+1, (int)vcount+1, yuv2rgb(y,u,v));
             }
             
             if (dbg_on) printf(" Rising edge on HS @ cycle #%llu (vcount = %d)\n", cycle, vcount);
@@ -620,15 +681,7 @@ vluint8_t VideoOut::eval_YUV420_DE
                 ret = dump_act;
                 if (dbg_on) printf(" Rising edge on VS @ cycle #%llu\n", cycle);
                 
-                if (dump_act)
-                {
-                    char tmp[264];
-                    
-                    sprintf(tmp, "%s_%04d.bmp", filename, dump_ctr);
-                    printf(" Save snapshot in file \"%s\"\n", tmp);
-                    bmp->WriteToFile(tmp);
-                    dump_ctr++;
-                }
+                if (dump_act) save_frame();
             }
         }
     }
@@ -637,6 +690,387 @@ vluint8_t VideoOut::eval_YUV420_DE
     return ret;
 }
 
+// Start / stop the writer thread
+void VideoOut::set_async(bool enable)
+{
+    if (enable && !wr_async)
+    {
+        pthread_mutex_init(&wr_mutex, NULL);
+        pthread_cond_init(&wr_cond_todo, NULL);
+        pthread_cond_init(&wr_cond_free, NULL);
+        wr_exit  = false;
+        wr_async = (pthread_create(&wr_thread, NULL, writer_thread, (void *)this) == 0);
+        if (!wr_async)
+        {
+            printf("Cannot create the writer thread, BMP files are saved synchronously\n");
+        }
+    }
+    else if (!enable && wr_async)
+    {
+        // writer thread exits once all the frames are written
+        pthread_mutex_lock(&wr_mutex);
+        wr_exit = true;
+        pthread_cond_signal(&wr_cond_todo);
+        pthread_mutex_unlock(&wr_mutex);
+        pthread_join(wr_thread, NULL);
+        pthread_cond_destroy(&wr_cond_todo);
+        pthread_cond_destroy(&wr_cond_free);
+        pthread_mutex_destroy(&wr_mutex);
+        wr_async = false;
+    }
+}
+
+// Save the captured frame into a BMP file
+void VideoOut::save_frame()
+{
+    char *tmp = name_ring[ring_wr];
+    
+    // frame scanned but not captured
+    if (!cap_on)
+    {
+        nat_err = (int)0;
+        skip_frame();
+        return;
+    }
+    
+    sprintf(tmp, "%s_%04d.bmp", filename, dump_ctr);
+    
+    // native resolution capture : replicated pixels check
+    if (nat_err)
+    {
+        printf(" Frame #%d : %d replicated pixels differ\n", dump_ctr, nat_err);
+        nat_err = (int)0;
+    }
+    
+    // hash mode : only save the frames that differ from the golden ones
+    if (hash_on)
+    {
+        vluint64_t hash = frame_hash(fb, fb_width * fb_height * 3);
+        
+        if (fh_hash) fprintf(fh_hash, "%04d %016llX\n", dump_ctr, hash);
+        if ((dump_ctr >= (int)golden.size()) || (golden[dump_ctr] == hash))
+        {
+            dump_ctr++;
+            return;
+        }
+        printf(" Frame #%d differs from the golden frame (%016llX instead of %016llX)\n",
+               dump_ctr, hash, golden[dump_ctr]);
+        if (hash_err < 0) hash_err = dump_ctr;
+    }
+    
+    printf(" Save snapshot in file \"%s\"\n", tmp);
+    dump_ctr++;
+    
+    if (wr_async)
+    {
+        // hand off the frame to the writer thread
+        pthread_mutex_lock(&wr_mutex);
+        ring_cnt++;
+        pthread_cond_signal(&wr_cond_todo);
+        // wait for a free frame buffer
+        while (ring_cnt == VIDEO_RING_SIZE)
+        {
+            pthread_cond_wait(&wr_cond_free, &wr_mutex);
+        }
+        pthread_mutex_unlock(&wr_mutex);
+        // capture the next frame into the next buffer
+        ring_wr = (ring_wr + 1) % VIDEO_RING_SIZE;
+        fb      = fb_ring[ring_wr];
+    }
+    else
+    {
+        write_bmp(fb, tmp);
+    }
+}
+
+// Convert a frame buffer to BMP and write it to disk
+void VideoOut::write_bmp(vluint8_t *buf, const char *name)
+{
+    RGBApixel pixel;
+    
+    // EasyBMP stores pixels column by column
+    pixel.Alpha = 0;
+    for (int i = 0; i < fb_width; i++)
+    {
+        vluint8_t *p = buf + i * 3;
+        
+        for (int j = 0; j < fb_height; j++)
+        {
+            pixel.Red   = p[0];
+            pixel.Green = p[1];
+            pixel.Blue  = p[2];
+            bmp->SetPixel(i, j, pixel);
+            p += fb_width * 3;
+        }
+    }
+    bmp->WriteToFile(name);
+}
+
+// Writer thread : save the frame buffers in the background
+void *VideoOut::writer_thread(void *arg)
+{
+    VideoOut *vo = (VideoOut *)arg;
+    
+    pthread_mutex_lock(&vo->wr_mutex);
+    while (true)
+    {
+        int idx;
+        
+        // wait for a frame to write
+        while ((vo->ring_cnt == 0) && (!vo->wr_exit))
+        {
+            pthread_cond_wait(&vo->wr_cond_todo, &vo->wr_mutex);
+        }
+        if (vo->ring_cnt == 0) break;
+        idx = vo->ring_rd;
+        pthread_mutex_unlock(&vo->wr_mutex);
+        
+        // disk access outside of the lock
+        vo->write_bmp(vo->fb_ring[idx], vo->name_ring[idx]);
+        
+        // free the frame buffer
+        pthread_mutex_lock(&vo->wr_mutex);
+        vo->ring_rd = (vo->ring_rd + 1) % VIDEO_RING_SIZE;
+        vo->ring_cnt--;
+        pthread_cond_signal(&vo->wr_cond_free);
+    }
+    pthread_mutex_unlock(&vo->wr_mutex);
+    
+    return NULL;
+}
+
+// Frame hashing : hashes are appended to a log file and compared against
+// a golden log (same format), the BMP files are only saved on mismatch
+void VideoOut::set_hash_mode(const char *log_file, const char *golden_file)
+{
+    hash_on = true;
+    
+    if (log_file)
+    {
+        if (fh_hash) fclose(fh_hash);
+        fh_hash = fopen(log_file, "w");
+        if (fh_hash)
+            printf("Frame hashes saved in file \"%s\"\n", log_file);
+        else
+            printf("Cannot create frame hashes file \"%s\" !!\n", log_file);
+    }
+    
+    if (golden_file)
+    {
+        FILE *fh = fopen(golden_file, "r");
+        
+        if (fh)
+        {
+            int                nr;
+            unsigned long long hash;
+            
+            while (fscanf(fh, "%d %llx", &nr, &hash) == 2)
+            {
+                if (nr < 0) continue;
+                if (nr >= (int)golden.size()) golden.resize(nr + 1, (vluint64_t)0);
+                golden[nr] = (vluint64_t)hash;
+            }
+            fclose(fh);
+            printf("%d golden frame hashes loaded from file \"%s\"\n", (int)golden.size(), golden_file);
+        }
+        else
+        {
+            printf("Cannot open golden frame hashes file \"%s\" !!\n", golden_file);
+        }
+    }
+}
+
+// Native resolution capture : the active area is upscaled by (hscale, vscale),
+// the native frame (hsize x vsize) starts at (hoffset, voffset) in the active
+// area. Only the first pixel of each block is kept, the other ones can be checked.
+// Must be called before the first frame is captured.
+void VideoOut::set_native(int hscale, int vscale, int hoffset, int voffset, int hsize, int vsize, bool check)
+{
+    if ((hscale < 1) || (vscale < 1) || (hsize < 1) || (vsize < 1) || (hoffset < 0) || (voffset < 0) ||
+        (hoffset + hsize * hscale > (int)hor_size) || (voffset + vsize * vscale > (int)ver_size))
+    {
+        printf("Invalid native resolution capture (%dx%d @ %d,%d, scale %dx%d) !!\n",
+               hsize, vsize, hoffset, voffset, hscale, vscale);
+        return;
+    }
+    
+    // pixel and line mapping
+    if (!nat_on)
+    {
+        nat_xpos = new int[hor_size];
+        nat_ypos = new int[ver_size];
+        nat_xrep = new bool[hor_size];
+        nat_yrep = new bool[ver_size];
+    }
+    for (int i = 0; i < (int)hor_size; i++)
+    {
+        int d = i - hoffset;
+        
+        nat_xpos[i] = ((d >= 0) && (d < hsize * hscale)) ? d / hscale : -1;
+        nat_xrep[i] = (d % hscale) != 0;
+    }
+    for (int i = 0; i < (int)ver_size; i++)
+    {
+        int d = i - voffset;
+        
+        nat_ypos[i] = ((d >= 0) && (d < vsize * vscale)) ? d / vscale : -1;
+        nat_yrep[i] = (d % vscale) != 0;
+    }
+    nat_on    = true;
+    nat_check = check;
+    nat_err   = (int)0;
+    
+    // smaller frame buffers
+    fb_width  = hsize;
+    fb_height = vsize;
+    for (int i = 0; i < VIDEO_RING_SIZE; i++)
+    {
+        delete [] fb_ring[i];
+        fb_ring[i] = new vluint8_t[fb_width * fb_height * 3];
+        memset((void *)fb_ring[i], 0, fb_width * fb_height * 3);
+    }
+    fb = fb_ring[ring_wr];
+    bmp->SetSize(fb_width, fb_height);
+    printf("Native resolution capture : %d x %d (scale %d x %d)\n", hsize, vsize, hscale, vscale);
+}
+
+// First frame that differs from the golden frames (-1 : none)
+int VideoOut::get_mismatch()
+{
+    return hash_err;
+}
+
+// Frames captured past the end of the golden frames (> 0) or golden frames
+// not reached (< 0), 0 without golden frames
+int VideoOut::get_golden_delta()
+{
+    return (golden.empty()) ? (int)0 : dump_ctr - (int)golden.size();
+}
+
+// 64-bit frame hash, 8 bytes at a time (frame buffer read as native words)
+vluint64_t VideoOut::frame_hash(const vluint8_t *buf, int size)
+{
+    vluint64_t h = (vluint64_t)0x9E3779B97F4A7C15ULL ^ (vluint64_t)size;
+    vluint64_t w;
+    int        i;
+    
+    for (i = 0; i + 8 <= size; i += 8)
+    {
+        memcpy((void *)&w, (void *)(buf + i), 8);
+        h  = (h ^ w) * (vluint64_t)0xFF51AFD7ED558CCDULL;
+        h ^= h >> 32;
+    }
+    for (; i < size; i++)
+    {
+        h  = (h ^ (vluint64_t)buf[i]) * (vluint64_t)0xFF51AFD7ED558CCDULL;
+        h ^= h >> 32;
+    }
+    
+    return h;
+}
+
+#if VM_SAVABLE
+// Save the frame being captured and the counters (checkpoint)
+void VideoOut::save_state(VerilatedSerialize &os)
+{
+    int geom[4] = { (int)hor_size, (int)ver_size, fb_width, fb_height };
+    
+    os.write((void *)geom, sizeof(geom));
+    os.write((void *)fb, fb_width * fb_height * 3);
+    for (int i = 0; i < 8; i++)
+    {
+        os.write((void *)y_buf[i],   sizeof(int) * hor_size);
+        os.write((void *)y_buf[i+8], sizeof(int) * hor_size);
+        os.write((void *)c_buf[i],   sizeof(int) * hor_size);
+    }
+    os.write((void *)&y0,       sizeof(y0));
+    os.write((void *)&u0,       sizeof(u0));
+    os.write((void *)&idx_yc,   sizeof(idx_yc));
+    os.write((void *)&hcount1,  sizeof(hcount1));
+    os.write((void *)&hcount2,  sizeof(hcount2));
+    os.write((void *)&hcount,   sizeof(hcount));
+    os.write((void *)&vcount1,  sizeof(vcount1));
+    os.write((void *)&vcount2,  sizeof(vcount2));
+    os.write((void *)&vcount,   sizeof(vcount));
+    os.write((void *)&prev_clk, sizeof(prev_clk));
+    os.write((void *)&prev_hs,  sizeof(prev_hs));
+    os.write((void *)&prev_vs,  sizeof(prev_vs));
+    os.write((void *)&dump_act, sizeof(dump_act));
+    os.write((void *)&dump_ctr, sizeof(dump_ctr));
+    os.write((void *)&nat_err,  sizeof(nat_err));
+    os.write((void *)&hash_err, sizeof(hash_err));
+}
+
+// Restore the frame being captured and the counters (checkpoint)
+bool VideoOut::restore_state(VerilatedDeserialize &is)
+{
+    int geom[4];
+    
+    is.read((void *)geom, sizeof(geom));
+    if ((geom[0] != (int)hor_size) || (geom[1] != (int)ver_size) || (geom[2] != fb_width) || (geom[3] != fb_height))
+    {
+        printf("Checkpoint does not match the video format (%d x %d, frame %d x %d) !!\n",
+               geom[0], geom[1], geom[2], geom[3]);
+        return false;
+    }
+    
+    is.read((void *)fb, fb_width * fb_height * 3);
+    for (int i = 0; i < 8; i++)
+    {
+        is.read((void *)y_buf[i],   sizeof(int) * hor_size);
+        is.read((void *)y_buf[i+8], sizeof(int) * hor_size);
+        is.read((void *)c_buf[i],   sizeof(int) * hor_size);
+    }
+    is.read((void *)&y0,       sizeof(y0));
+    is.read((void *)&u0,       sizeof(u0));
+    is.read((void *)&idx_yc,   sizeof(idx_yc));
+    is.read((void *)&hcount1,  sizeof(hcount1));
+    is.read((void *)&hcount2,  sizeof(hcount2));
+    is.read((void *)&hcount,   sizeof(hcount));
+    is.read((void *)&vcount1,  sizeof(vcount1));
+    is.read((void *)&vcount2,  sizeof(vcount2));
+    is.read((void *)&vcount,   sizeof(vcount));
+    is.read((void *)&prev_clk, sizeof(prev_clk));
+    is.read((void *)&prev_hs,  sizeof(prev_hs));
+    is.read((void *)&prev_vs,  sizeof(prev_vs));
+    is.read((void *)&dump_act, sizeof(dump_act));
+    is.read((void *)&dump_ctr, sizeof(dump_ctr));
+    is.read((void *)&nat_err,  sizeof(nat_err));
+    is.read((void *)&hash_err, sizeof(hash_err));
+    
+    return true;
+}
+#endif /* VM_SAVABLE */
+
+// Frame not captured (video clock stopped) : only the frame counter is advanced
+vluint8_t VideoOut::skip_frame()
+{
+    dump_ctr++;
+    
+    return (vluint8_t)1;
+}
+
+// Frames capture on/off : the frames still scanned while it is off are only
+// counted, like the skipped ones
+void VideoOut::set_capture(bool enable)
+{
+    cap_on = enable;
+}
+
+// Restart the scanning from the top of the frame (video clock restarted) :
+// the partially captured frame is dropped
+void VideoOut::resync()
+{
+    hcount1  = (vluint16_t)0;
+    hcount2  = (vluint16_t)0;
+    hcount   = (vluint16_t)0;
+    vcount1  = (vluint16_t)0;
+    vcount2  = (vluint16_t)0;
+    vcount   = (vluint16_t)0;
+    idx_yc   = (int)0;
+    nat_err  = (int)0;
+}
+
 vluint16_t VideoOut::get_hcount()
 {
     return hcount;
@@ -19,11 +19,16 @@
 // -------------
 //  - Allows to translate VGA signals from a simulation into BMP files
 //  - It is designed to work with "Verilator" (www.veripool.org)
-//  - It uses the EasyBMP class (easybmp.sourceforge.net)
+//  - Frames are captured in a row-major, packed RGB buffer
+//  - It uses the EasyBMP class (easybmp.sourceforge.net) to save them
 //  - Synchros polarities are configurable
 //  - Active and total areas are configurable
 //  - HS/VS or DE based scanning
 //  - BMP files are saved on VS edge
+//  - Optional writer thread to save BMP files in the background
+//  - Optional per-frame hash log, compared against golden hashes
+//  - Optional native resolution capture (upscaled pixels decimated on the fly)
+//  - Frames can be skipped and the scanning resynchronized (video clock stopped)
 //  - Support for RGB444, YUV444, YUV422 and YUV420 colorspaces
 //
 
@@ -31,13 +36,21 @@
 #define _VIDEO_OUT_H_
 
 #include "verilated.h"
+#if VM_SAVABLE
+#include "verilated_save.h"
+#endif /* VM_SAVABLE */
 #include "../easy_bmp/EasyBMP.h"
+#include <pthread.h>
+#include <vector>
 
 #define HS_POS_POL (1)
 #define HS_NEG_POL (0)
 #define VS_POS_POL (2)
 #define VS_NEG_POL (0)
 
+// Number of frame buffers for the writer thread
+#define VIDEO_RING_SIZE (3)
+
 class VideoOut
 {
     public:
@@ -47,6 +60,7 @@ class VideoOut
         // Methods
         vluint8_t eval_RGB444_HV(vluint64_t cycle, vluint8_t clk, vluint8_t vs,   vluint8_t hs,   vluint8_t red,  vluint8_t green, vluint8_t blue);
         vluint8_t eval_RGB444_DE(vluint64_t cycle, vluint8_t clk, vluint8_t de,                   vluint8_t red,  vluint8_t green, vluint8_t blue);
+        vluint8_t eval_RGB444_DE_posedge(vluint64_t cycle,        vluint8_t de,                   vluint8_t red,  vluint8_t green, vluint8_t blue);
         vluint8_t eval_YUV444_HV(vluint64_t cycle, vluint8_t clk, vluint8_t vs,   vluint8_t hs,   vluint8_t luma, vluint8_t cb,    vluint8_t cr);
         vluint8_t eval_YUV444_DE(vluint64_t cycle, vluint8_t clk, vluint8_t de,                   vluint8_t luma, vluint8_t cb,    vluint8_t cr);
         vluint8_t eval_YUV422_HV(vluint64_t cycle, vluint8_t clk, vluint8_t vs,   vluint8_t hs,   vluint8_t luma, vluint8_t chroma);
@@ -54,8 +68,26 @@ class VideoOut
         vluint8_t eval_YUV420_DE(vluint64_t cycle, vluint8_t clk, vluint8_t de_y, vluint8_t de_c, vluint8_t luma, vluint8_t chroma);
         vluint16_t get_hcount();
         vluint16_t get_vcount();
+        void       set_async(bool enable);
+        void       set_hash_mode(const char *log_file, const char *golden_file);
+        int        get_mismatch();
+        int        get_golden_delta();
+        void       set_native(int hscale, int vscale, int hoffset, int voffset, int hsize, int vsize, bool check);
+        vluint8_t  skip_frame();
+        void       set_capture(bool enable);
+        void       resync();
+#if VM_SAVABLE
+        void       save_state(VerilatedSerialize &os);
+        bool       restore_state(VerilatedDeserialize &is);
+#endif /* VM_SAVABLE */
     private:
         RGBApixel yuv2rgb(int lum, int cb, int cr);
+        void       put_pixel(int x, int y, RGBApixel pixel);
+        void       put_native(int x, int y, RGBApixel pixel);
+        void       save_frame();
+        void       write_bmp(vluint8_t *buf, const char *name);
+        static void *writer_thread(void *arg);
+        static vluint64_t frame_hash(const vluint8_t *buf, int size);
         // Color depth
         int        bit_shift;
         vluint8_t  bit_mask;
@@ -80,10 +112,41 @@ class VideoOut
         // YUV420
         int       *y_buf[16];
         int       *c_buf[8];
-        // BMP file
+        // Frame buffer being captured (row-major, 3 bytes per pixel : R, G, B)
+        vluint8_t *fb;
+        int        fb_width;
+        int        fb_height;
+        // Native resolution capture
+        bool       nat_on;
+        bool       nat_check;                          // Check the replicated pixels
+        int       *nat_xpos;                           // Native column of each pixel (-1 : cropped)
+        int       *nat_ypos;                           // Native line of each line (-1 : cropped)
+        bool      *nat_xrep;                           // Replicated column
+        bool      *nat_yrep;                           // Replicated line
+        int        nat_err;                            // Replicated pixels that differ (current frame)
+        // Scanned frames are saved (or hashed)
+        bool       cap_on;
+        // BMP file (only used to save a frame)
         BMP       *bmp;
         // BMP file name
         char       filename[256];
+        // Writer thread
+        bool       wr_async;                           // Writer thread running
+        bool       wr_exit;                            // Writer thread must exit
+        pthread_t  wr_thread;
+        pthread_mutex_t wr_mutex;
+        pthread_cond_t  wr_cond_todo;                  // A frame is ready to be written
+        pthread_cond_t  wr_cond_free;                  // A frame buffer has been freed
+        vluint8_t *fb_ring[VIDEO_RING_SIZE];           // Frame buffers
+        char       name_ring[VIDEO_RING_SIZE][264];    // Frame file names
+        int        ring_wr;                            // Frame buffer being captured
+        int        ring_rd;                            // Next frame buffer to write
+        int        ring_cnt;                           // Frame buffers waiting to be written
+        // Frame hashing
+        bool       hash_on;                            // Only save the frames that differ from the golden ones
+        FILE      *fh_hash;                            // Per-frame hash log
+        std::vector<vluint64_t> golden;                // Golden hashes (indexed by frame number)
+        int        hash_err;                           // First diverging frame (-1 : none)
         // Internal variable
         int        idx_yc;
         vluint16_t hcount1;